@@ -31,6 +31,14 @@
 //
 
 #include "Icsiboost.hpp"
+#include "SfannParse.hpp"
+#include "SfannInput.hpp"
+#include "SfannMemory.hpp"
+#include "SfannSparse.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 
 using namespace std;
@@ -52,6 +60,18 @@ int IcsiboostNames::getNeededNeurons() {
     return this->neededNeurons;
 }
 
+int IcsiboostNames::getTextNeurons() {
+    int res = 0;
+    for (size_t i=0; i<this->parameters.size(); i++) {
+        if (this->textParameters[i]) res += this->parameters[i]->getNeededNeurons();
+    }
+    return res;
+}
+
+bool IcsiboostNames::isText(int num) {
+    return num >= 0 && num < (int)this->textParameters.size() && this->textParameters[num];
+}
+
 bool IcsiboostNames::isCommentLine(const string & line) {
     size_t diese = line.find_first_of("#|");
     return (line.find_first_not_of(" \t") == string::npos || diese < line.find_first_not_of(" #|\t"));
@@ -87,7 +107,10 @@ void IcsiboostNames::loadFile(const string & file) throw (SfannException) {
         }
         this->parameters.clear();
         this->parameterNames.clear();
+        this->neuronOffsets.clear();
+        this->textParameters.clear();
         this->parameterNums.clear();
+        this->neededNeurons = 0;
 
         this->file_path = file;
         int num_line = 0;
@@ -101,7 +124,6 @@ void IcsiboostNames::loadFile(const string & file) throw (SfannException) {
             throw SfannException("The file " + file + " does not contain a valid line !\n");
         }
         
-        int num_parameter = 0;
         while(! f.eof()) {
             IcsiboostNames::readNext(f, line, num_line, true);
             if (line.size() > 0) {
@@ -117,11 +139,22 @@ void IcsiboostNames::loadFile(const string & file) throw (SfannException) {
                     oss << "Error in " << file << ": duplicated parameter names at line " << num_line << " !";
                     throw *new SfannException(oss.str());
                 }
-                this->parameters[num_parameter] = IcsiboostParameterFactory::createIcsiboostParameter(tokens.back());
-                this->parameterNums[tokens.front()] = num_parameter;
-                this->parameterNames[num_parameter] = tokens.front();
-                this->neededNeurons += this->parameters[num_parameter]->getNeededNeurons();
-                num_parameter++;
+                this->parameterNums[tokens.front()] = this->parameters.size();
+                this->parameters.push_back(IcsiboostParameterFactory::createIcsiboostParameter(tokens.back()));
+                this->parameterNames.push_back(tokens.front());
+                this->textParameters.push_back(dynamic_cast<IcsiboostParameterText *>(this->parameters.back()) != NULL);
+                this->neededNeurons += this->parameters.back()->getNeededNeurons();
+            }
+        }
+
+        // the text buckets come after all the other inputs, so that the loader can keep them apart
+        this->neuronOffsets.assign(this->parameters.size(), 0);
+        int offset = 0;
+        for (int text = 0; text < 2; text++) {
+            for (size_t i=0; i<this->parameters.size(); i++) {
+                if ((int)this->textParameters[i] != text) continue;
+                this->neuronOffsets[i] = offset;
+                offset += this->parameters[i]->getNeededNeurons();
             }
         }
     } else {
@@ -130,7 +163,10 @@ void IcsiboostNames::loadFile(const string & file) throw (SfannException) {
 }
 
 string IcsiboostNames::getParameterName(int num) {
-    return this->parameterNames[num];
+    if (num >= 0 && num < (int)this->parameterNames.size())
+        return this->parameterNames[num];
+    else
+        return string();
 }
 
 int IcsiboostNames::getParameterNum(string name) {
@@ -138,7 +174,7 @@ int IcsiboostNames::getParameterNum(string name) {
 }
 
 IcsiboostParameterType * IcsiboostNames::getParameter(string name) {
-    if (this->parameterNums.count(name) > 0 && this->parameters.count(this->parameterNums[name]) > 0)
+    if (this->parameterNums.count(name) > 0)
         return this->parameters[this->parameterNums[name]];
     else
         return NULL;
@@ -149,12 +185,16 @@ IcsiboostParameterType * IcsiboostNames::getLabels() {
 }
 
 IcsiboostParameterType * IcsiboostNames::getParameter(int num) {
-    if (this->parameters.count(num) > 0)
+    if (num >= 0 && num < (int)this->parameters.size())
         return this->parameters[num];
     else
         return NULL;
 }
 
+int IcsiboostNames::getNeuronOffset(int num) {
+    return this->neuronOffsets[num];
+}
+
 int IcsiboostNames::getNbParameters() {
     return this->parameters.size();
 }
@@ -164,8 +204,8 @@ string IcsiboostNames::toString() {
         string res;
         res += "Detected " + this->labels->toString() + "\n";
         res += "Parameters :\n";
-        for (map <int, IcsiboostParameterType*>::iterator it = this->parameters.begin(); it != this->parameters.end(); ++it) {
-            res += "    - " + this->parameterNames[it->first] + " : " + it->second->toString() + "\n";
+        for (size_t i = 0; i < this->parameters.size(); ++i) {
+            res += "    - " + this->parameterNames[i] + " : " + this->parameters[i]->toString() + "\n";
         }
         return res;
     } else {
@@ -178,78 +218,202 @@ string IcsiboostNames::toString() {
 
 fann_type * IcsiboostDataParser::convertIcsiExempleToFannInput(const string & exemple_line, IcsiboostNames & names) {
     fann_type * res = new fann_type[names.getNeededNeurons()];
-    int ires = 0;
+    IcsiboostDataParser::fillIcsiExempleFannInput(exemple_line, names, res);
+    return res;
+}
 
+void IcsiboostDataParser::fillIcsiExempleFannInput(const string & exemple_line, IcsiboostNames & names, fann_type * res) {
     vector<string> param_vals;
     IcsiboostUtils::tokenize(exemple_line, param_vals, ",", true);
     if (param_vals.size() != names.getNbParameters()+1) {
         throw *new SfannException("Bad number of parameter values in data line ("+exemple_line+")");
     }
     
+    // each parameter is written directly at its place in the input vector
     for (int i=0; i < param_vals.size()-1; ++i) {
-        fann_type * tmp = names.getParameter(i)->convertToNeuralRepresentation(param_vals[i]);
-        for (int j=0; j<names.getParameter(i)->getNeededNeurons(); j++) {
-            res[ires++] = tmp[j];
-        }
-        delete tmp;
+        names.getParameter(i)->fillNeuralRepresentation(param_vals[i], res + names.getNeuronOffset(i));
     }
-    
-    return res;
 }
 
 fann_type * IcsiboostDataParser::convertIcsiExempleToFannOutput(const string & exemple_line, IcsiboostNames & names) {
+    fann_type * res = new fann_type[names.getLabels()->getNeededNeurons()];
+    IcsiboostDataParser::fillIcsiExempleFannOutput(exemple_line, names, res);
+    return res;
+}
+
+void IcsiboostDataParser::fillIcsiExempleSparseInput(const string & exemple_line, IcsiboostNames & names, fann_type * res, vector<unsigned int> & text) {
+    vector<string> param_vals;
+    IcsiboostUtils::tokenize(exemple_line, param_vals, ",", true);
+    if (param_vals.size() != names.getNbParameters()+1) {
+        throw *new SfannException("Bad number of parameter values in data line ("+exemple_line+")");
+    }
+
+    int first_text = names.getNeededNeurons() - names.getTextNeurons();
+    for (int i=0; i < param_vals.size()-1; ++i) {
+        if (names.isText(i)) {
+            ((IcsiboostParameterText *)names.getParameter(i))->activeBuckets(param_vals[i], text, names.getNeuronOffset(i) - first_text);
+        } else {
+            names.getParameter(i)->fillNeuralRepresentation(param_vals[i], res + names.getNeuronOffset(i));
+        }
+    }
+}
+
+void IcsiboostDataParser::fillIcsiExempleFannOutput(const string & exemple_line, IcsiboostNames & names, fann_type * res) {
     size_t deb = exemple_line.find_last_of(",");
     size_t fin = exemple_line.find_last_of(".");
     IcsiboostUtils::stripSpacePositions(exemple_line, deb, fin);
-    return names.getLabels()->convertToNeuralRepresentation(exemple_line.substr(deb, fin-deb));
+    names.getLabels()->fillNeuralRepresentation(exemple_line.substr(deb, fin-deb), res);
 }
 
 struct fann_train_data * IcsiboostDataParser::loadDataToFann(const string & file, IcsiboostNames & names) throw (SfannException) {
     vector<string> file_content;
     
-    ifstream f(file.c_str());
-    if (f.is_open()) {
-        string line;
-        int num_line = 0;
-        while(! f.eof()) {
-            getline(f, line);
-            num_line++;
-            // skip comments and blank lines
-            size_t diese = line.find_first_of("#|");
-            if (line.size() > 0 && (diese == string::npos || diese > line.find_first_not_of(" #|\t"))) {
-                file_content.push_back(line);
-            }
+    // plain, gzip or zstd file, decompressed by a separate thread while the lines are read
+    SfannInput f(file);
+    string line;
+    while (f.getline(line)) {
+        // skip comments and blank lines
+        size_t diese = line.find_first_of("#|");
+        if (line.size() > 0 && (diese == string::npos || diese > line.find_first_not_of(" #|\t"))) {
+            file_content.push_back(line);
         }
-    } else {
-        ostringstream oss;
-        oss << "Impossible read of " << file << " !";
-        throw *new SfannException(oss.str());
     }
 
     int nb_exemples = file_content.size();
-    int nb_input = names.getNeededNeurons();
+    // the text buckets are not stored as inputs
+    int nb_text = names.getTextNeurons();
+    int nb_input = names.getNeededNeurons() - nb_text;
     int nb_output = names.getLabels()->getNeededNeurons();
 
-    struct fann_train_data * res = new struct fann_train_data;
-    
-    res->errno_f = FANN_E_NO_ERROR;
-    res->error_log = NULL;
-    res->errstr = NULL;
-    res->num_input = nb_input;
-    res->num_output = nb_output;
-    res->num_data = nb_exemples;
+    // the examples are counted (--memory-limit) before they are allocated, their text buckets once they are known
+    unsigned long long bytes = SfannMemory::data_size(nb_exemples, nb_input, nb_output);
+    try {
+        SfannMemory::allocate(SFANN_MEM_DATASETS, bytes);
+    } catch (SfannException & e) {
+        throw SfannException(file + " : " + e.what());
+    }
+
+    struct fann_train_data * res;
 
     if (nb_exemples <= 0) {
+        res = new struct fann_train_data;
+        res->errno_f = FANN_E_NO_ERROR;
+        res->error_log = NULL;
+        res->errstr = NULL;
+        res->num_input = nb_input;
+        res->num_output = nb_output;
+        res->num_data = nb_exemples;
         res->input = NULL;
         res->output = NULL;
+    } else if (nb_text > 0) {
+        res = IcsiboostDataParser::loadTextDataToFann(file, file_content, names, bytes);
     } else {
-        res->input = new fann_type * [nb_exemples];
-        for (int i=0; i<nb_exemples; i++) res->input[i] = IcsiboostDataParser::convertIcsiExempleToFannInput(file_content[i], names);
+        // one contiguous block for all the examples, as the FANN reader (released by fann_destroy_train)
+        res = fann_create_train(nb_exemples, nb_input, nb_output);
+        if (res == NULL) {
+            SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+            throw SfannException("Impossible allocation of the examples of " + file + " !");
+        }
+        try {
+            for (int i=0; i<nb_exemples; i++) {
+                IcsiboostDataParser::fillIcsiExempleFannInput(file_content[i], names, res->input[i]);
+                IcsiboostDataParser::fillIcsiExempleFannOutput(file_content[i], names, res->output[i]);
+            }
+        } catch (SfannException & e) {
+            fann_destroy_train(res);
+            SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+            throw;
+        }
+    }
+
+    return res;
+}
+
+// <rows> enlarged to at least <needed> values, NULL if impossible (<rows> is then still allocated)
+static fann_type * growRows(fann_type * rows, size_t & capacity, size_t needed) {
+    if (needed <= capacity) return rows;
+    size_t grown_capacity = capacity * 2 > needed ? capacity * 2 : needed;
+    fann_type * grown = (fann_type *) realloc(rows, grown_capacity * sizeof(fann_type));
+    if (grown != NULL) capacity = grown_capacity;
+    return grown;
+}
 
-        res->output = new fann_type * [nb_exemples];
-        for (int i=0; i<nb_exemples; i++) res->output[i] = IcsiboostDataParser::convertIcsiExempleToFannOutput(file_content[i], names);
+struct fann_train_data * IcsiboostDataParser::loadTextDataToFann(const string & file, const vector<string> & lines, IcsiboostNames & names, unsigned long long bytes) throw (SfannException) {
+    int nb_exemples = lines.size();
+    int nb_text = names.getTextNeurons();
+    int nb_input = names.getNeededNeurons() - nb_text;
+    int nb_output = names.getLabels()->getNeededNeurons();
+
+    // the bucket numbers are stored as fann_type values, exact up to 2^24
+    if (nb_text > (1 << 24)) {
+        SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+        throw SfannException(file + " : too many text buckets (at most 16777216 for all the text parameters)");
+    }
+
+    // outputs and row pointers allocated by FANN, so that fann_destroy_train releases the examples
+    struct fann_train_data * res = fann_create_train(nb_exemples, 1, nb_output);
+    if (res == NULL) {
+        SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+        throw SfannException("Impossible allocation of the examples of " + file + " !");
+    }
+
+    // one block for all the input rows : the other inputs, the number of buckets set to 1, then their numbers
+    vector<size_t> starts(nb_exemples);
+    size_t capacity = (size_t)nb_exemples * (nb_input + 2);
+    size_t used = 0;
+    fann_type * rows = (fann_type *) malloc(capacity * sizeof(fann_type));
+    vector<unsigned int> text;
+    try {
+        if (rows == NULL) {
+            throw SfannException("Impossible allocation of the examples of " + file + " !");
+        }
+        for (int i=0; i<nb_exemples; i++) {
+            fann_type * grown = growRows(rows, capacity, used + nb_input + 1);
+            if (grown == NULL) throw SfannException("Impossible allocation of the examples of " + file + " !");
+            rows = grown;
+
+            text.clear();
+            IcsiboostDataParser::fillIcsiExempleSparseInput(lines[i], names, rows + used, text);
+            IcsiboostDataParser::fillIcsiExempleFannOutput(lines[i], names, res->output[i]);
+
+            grown = growRows(rows, capacity, used + nb_input + 1 + text.size());
+            if (grown == NULL) throw SfannException("Impossible allocation of the examples of " + file + " !");
+            rows = grown;
+
+            starts[i] = used;
+            fann_type * row = rows + used;
+            row[nb_input] = (fann_type)text.size();
+            for (size_t k=0; k<text.size(); k++) row[nb_input + 1 + k] = (fann_type)text[k];
+            used += nb_input + 1 + text.size();
+        }
+    } catch (SfannException & e) {
+        free(rows);
+        fann_destroy_train(res);
+        SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+        throw;
     }
 
+    // the text buckets are counted once they are known
+    unsigned long long text_bytes = (unsigned long long)(used - (size_t)nb_exemples * nb_input) * sizeof(fann_type);
+    try {
+        SfannMemory::allocate(SFANN_MEM_DATASETS, text_bytes);
+    } catch (SfannException & e) {
+        free(rows);
+        fann_destroy_train(res);
+        SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+        throw SfannException(file + " : " + e.what());
+    }
+
+    fann_type * fitted = (fann_type *) realloc(rows, used * sizeof(fann_type));
+    if (fitted != NULL) rows = fitted;
+
+    // the block of fann_create_train is replaced by the rows
+    free(res->input[0]);
+    for (int i=0; i<nb_exemples; i++) {
+        res->input[i] = rows + starts[i];
+    }
+    res->num_input = nb_input;
+    SfannSparse::add_text(res, nb_text, used);
     return res;
 }
 
@@ -268,14 +432,9 @@ string IcsiboostParameterContinuous::toString() {
 	return string("continuous");
 }
 
-// unknown values are set to 0
 fann_type * IcsiboostParameterContinuous::convertToNeuralRepresentation(const string & icsi_data) throw (SfannException) {
     fann_type * res = new fann_type[1];
-    if (icsi_data.find_first_of("?") != string::npos) {
-        res[0] = 0.;
-    } else {
-        sscanf(icsi_data.c_str(), "%f", res);
-    }
+    this->fillNeuralRepresentation(icsi_data, res);
 
 /*    istringstream iss (icsi_data);
     double t;
@@ -290,6 +449,75 @@ fann_type * IcsiboostParameterContinuous::convertToNeuralRepresentation(const st
     return res;
 }
 
+// unknown values are set to 0
+void IcsiboostParameterContinuous::fillNeuralRepresentation(const string & icsi_data, fann_type * dest) throw (SfannException) {
+    const char * p = icsi_data.data();
+    if (icsi_data.find_first_of("?") != string::npos) {
+        dest[0] = 0.;
+    } else if (!SfannParse::parse_float(p, icsi_data.data() + icsi_data.size(), dest[0])) {
+        // unreadable values are handled as unknown ones
+        dest[0] = 0.;
+    }
+}
+
+
+//  ParameterText
+
+IcsiboostParameterText::IcsiboostParameterText(int buckets, int ngrams) {
+    this->buckets = buckets;
+    this->ngrams = ngrams;
+}
+
+int IcsiboostParameterText::getNeededNeurons() throw (SfannException) {
+    return this->buckets;
+}
+
+string IcsiboostParameterText::toString() {
+    ostringstream oss;
+    oss << "text (" << this->buckets << " hashed buckets, n-grams up to " << this->ngrams << ")";
+    return oss.str();
+}
+
+fann_type * IcsiboostParameterText::convertToNeuralRepresentation(const string & icsi_data) throw (SfannException) {
+    fann_type * res = new fann_type[this->buckets];
+    this->fillNeuralRepresentation(icsi_data, res);
+    return res;
+}
+
+void IcsiboostParameterText::fillNeuralRepresentation(const string & icsi_data, fann_type * res) throw (SfannException) {
+    for (int i=0; i<this->buckets; i++)
+        res[i] = -1;
+
+    vector<unsigned int> active;
+    this->activeBuckets(icsi_data, active, 0);
+    for (size_t k=0; k<active.size(); k++)
+        res[active[k]] = 1;
+}
+
+// unknown values (?) set no bucket
+void IcsiboostParameterText::activeBuckets(const string & icsi_data, vector<unsigned int> & active, unsigned int offset) {
+    vector<string> tokens;
+    IcsiboostUtils::tokenize(icsi_data, tokens, " \t", false);
+    if (tokens.size() == 1 && tokens[0] == "?") {
+        return;
+    }
+
+    // n-gram tokens[i..i+n-1] hashed as "tokens[i] tokens[i+1] ..."
+    size_t start = active.size();
+    for (size_t i=0; i<tokens.size(); i++) {
+        unsigned int h = IcsiboostUtils::hash(tokens[i]);
+        active.push_back(offset + h % this->buckets);
+        for (int n=1; n<this->ngrams && i+n < tokens.size(); n++) {
+            h = IcsiboostUtils::hash(tokens[i+n], IcsiboostUtils::hash(" ", 1, h));
+            active.push_back(offset + h % this->buckets);
+        }
+    }
+
+    // each bucket once, as the neuron it stands for
+    sort(active.begin() + start, active.end());
+    active.erase(unique(active.begin() + start, active.end()), active.end());
+}
+
 
 // ParameterLabels
 
@@ -298,53 +526,84 @@ IcsiboostParameterLabels::IcsiboostParameterLabels(const string & icsi_param_des
 }
 
 void IcsiboostParameterLabels::setLabels(const string & icsi_param_description) {
-    this->label2id.clear();
     this->id2label.clear();
-    
+
     vector<string> tokens;
     IcsiboostUtils::tokenize(icsi_param_description, tokens, ".,", true);
 
+    // ids in order of first appearance
+    map <string, int> seen;
     for (vector<string>::iterator it = tokens.begin(); it != tokens.end(); ++it) {
-        if (this->label2id.count((*it)) <= 0) {
-            int id = this->label2id.size();
-            this->label2id[(*it)] = id;
-            this->id2label[id] = (*it);
+        if (seen.count((*it)) <= 0) {
+            seen[(*it)] = this->id2label.size();
+            this->id2label.push_back(*it);
         }
     }
+    this->buildTable();
+}
+
+// table at most half full, so that the probe sequences stay short
+void IcsiboostParameterLabels::buildTable() {
+    unsigned int size = 8;
+    while (size < 2 * this->id2label.size()) size *= 2;
+    this->slots.assign(size, -1);
+    this->mask = size - 1;
+
+    for (int id = 0; id < (int)this->id2label.size(); id++) {
+        unsigned int s = IcsiboostUtils::hash(this->id2label[id]) & this->mask;
+        while (this->slots[s] >= 0) s = (s + 1) & this->mask;
+        this->slots[s] = id;
+    }
+}
+
+int IcsiboostParameterLabels::getLabelId(const char * label, size_t len) {
+    unsigned int s = IcsiboostUtils::hash(label, len) & this->mask;
+    while (this->slots[s] >= 0) {
+        const string & candidate = this->id2label[this->slots[s]];
+        if (candidate.size() == len && candidate.compare(0, len, label, len) == 0) return this->slots[s];
+        s = (s + 1) & this->mask;
+    }
+    return -1;
 }
 
 string IcsiboostParameterLabels::toString() {
 	ostringstream oss;
 	oss << "Labels: ";
-	for (map<int, string>::iterator it = this->id2label.begin();
-		it != this->id2label.end();
-		++it) {
-		oss << it->first << "=" << it->second << " ";
+	for (size_t id = 0; id < this->id2label.size(); ++id) {
+		oss << id << "=" << this->id2label[id] << " ";
 	}
 	return oss.str();
 }
 
 
 int IcsiboostParameterLabels::getNeededNeurons() throw (SfannException) {
-    return this->label2id.size();
+    return this->id2label.size();
 }
 
-// When the label is unknown (?), all the outputs are set to -1
 fann_type * IcsiboostParameterLabels::convertToNeuralRepresentation(const string & icsi_data) throw (SfannException) {
-    fann_type * res = new fann_type[this->label2id.size()];
-    for(int i=0; i<this->label2id.size(); i++)
-        res[i] = -1;
+    fann_type * res = new fann_type[this->id2label.size()];
+    this->fillNeuralRepresentation(icsi_data, res);
+    return res;
+}
 
-    vector<string> tokens;
-    IcsiboostUtils::tokenize(icsi_data, tokens, ",.", true);
+// When the label is unknown (?), all the outputs are set to -1
+void IcsiboostParameterLabels::fillNeuralRepresentation(const string & icsi_data, fann_type * res) throw (SfannException) {
+    for(int i=0; i<this->id2label.size(); i++)
+        res[i] = -1;
 
-    for (vector<string>::iterator it = tokens.begin(); it != tokens.end(); ++it) {
-        if (this->label2id.count(*it) > 0) {
-            res[this->label2id[(*it)]] = 1;
+    // labels separated by ',' or '.', looked up in place (same tokens as IcsiboostUtils::tokenize)
+    size_t pos = 0;
+    while (pos < icsi_data.size()) {
+        size_t end = icsi_data.find_first_of(",.", pos);
+        if (end == string::npos) end = icsi_data.size();
+        size_t deb = pos, fin = end;
+        IcsiboostUtils::stripSpacePositions(icsi_data, deb, fin);
+        if (fin > deb) {
+            int id = this->getLabelId(icsi_data.data() + deb, fin - deb);
+            if (id >= 0) res[id] = 1;
         }
+        pos = end + 1;
     }
-    
-    return res;
 }
 
 
@@ -375,9 +634,29 @@ void IcsiboostUtils::stripSpacePositions(const string& str, size_t & deb, size_t
     while(deb < str.size() && str[deb] == ' ') deb++;
 }
 
+unsigned int IcsiboostUtils::hash(const string& str, unsigned int h) {
+    return IcsiboostUtils::hash(str.data(), str.size(), h);
+}
+
+unsigned int IcsiboostUtils::hash(const char * str, size_t len, unsigned int h) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)str[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
 
 // IcsiboostParameterFactory 
 
+int IcsiboostParameterFactory::text_buckets = 1024;
+int IcsiboostParameterFactory::text_ngrams = 1;
+
+void IcsiboostParameterFactory::setTextHashing(int buckets, int ngrams) {
+	IcsiboostParameterFactory::text_buckets = buckets;
+	IcsiboostParameterFactory::text_ngrams = ngrams;
+}
+
 IcsiboostParameterType * IcsiboostParameterFactory::createIcsiboostParameter(const string & icsi_def_line) throw (SfannException) {
 	string stripped = IcsiboostParameterFactory::stripString(icsi_def_line, "\t ");
 	if (stripped.compare("continuous.") == 0) {
@@ -385,7 +664,7 @@ IcsiboostParameterType * IcsiboostParameterFactory::createIcsiboostParameter(con
 		return new IcsiboostParameterContinuous();  
 	} else if (stripped.compare("text.") == 0) {
 //         cout << "Create text !" << endl;
-		return new IcsiboostParameterType();
+		return new IcsiboostParameterText(IcsiboostParameterFactory::text_buckets, IcsiboostParameterFactory::text_ngrams);
 	} else {
 //         cout << "Create labels !" << endl;
 		return new IcsiboostParameterLabels(stripped);
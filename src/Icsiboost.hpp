@@ -56,6 +56,8 @@ class IcsiboostParameterType {
         IcsiboostParameterType() {};
         virtual int getNeededNeurons() throw (SfannException) {return 0;};
         virtual fann_type * convertToNeuralRepresentation(const string & icsi_data) throw (SfannException) {return NULL;};
+        // writes the getNeededNeurons() values of <icsi_data> in <dest>, without allocation
+        virtual void fillNeuralRepresentation(const string & /*icsi_data*/, fann_type * /*dest*/) throw (SfannException) {};
         virtual string toString() {return string("nothing");};
         virtual ~IcsiboostParameterType() {};
 };
@@ -64,15 +66,22 @@ class IcsiboostParameterType {
 class IcsiboostParameterLabels : public IcsiboostParameterType {
 
     private:
-        map <string, int> label2id;
-        map <int, string> id2label;
+        vector <string> id2label;
+        // open addressing hash table of the labels : id of the label, or -1 for an empty slot
+        vector <int> slots;
+        unsigned int mask;
+
+        void buildTable();
 
     public:
 
         IcsiboostParameterLabels(const string & icsi_param_description);
         void setLabels(const string & icsi_param_description);
+        // id of the label <label> (<len> chars), -1 if unknown
+        int getLabelId(const char * label, size_t len);
         int getNeededNeurons() throw (SfannException);
         fann_type * convertToNeuralRepresentation(const string & icsi_data) throw (SfannException);
+        void fillNeuralRepresentation(const string & icsi_data, fann_type * dest) throw (SfannException);
         string toString();
 };
 
@@ -85,8 +94,12 @@ class IcsiboostNames {
         string file_path;
 
         IcsiboostParameterLabels * labels;
-        map <int, IcsiboostParameterType*> parameters;
-        map <int, string> parameterNames;
+        // indexed by parameter number, as the values in the data lines
+        vector <IcsiboostParameterType*> parameters;
+        vector <string> parameterNames;
+        // first input neuron of each parameter, the text parameters after all the others
+        vector <int> neuronOffsets;
+        vector <bool> textParameters;
         map <string, int> parameterNums;
         int neededNeurons;
 
@@ -103,10 +116,14 @@ class IcsiboostNames {
         int getParameterNum(string name);
         IcsiboostParameterType * getParameter(string name);
         IcsiboostParameterType * getParameter(int num);
+        int getNeuronOffset(int num);
         IcsiboostParameterType * getLabels();
         int getNbParameters();
 
         int getNeededNeurons();
+        // input neurons of the text parameters (hashed buckets), the last getTextNeurons() ones
+        int getTextNeurons();
+        bool isText(int num);
 
         string toString();
 };
@@ -117,7 +134,16 @@ class IcsiboostDataParser {
     public:
         static fann_type * convertIcsiExempleToFannInput(const string & exemple, IcsiboostNames & names);
         static fann_type * convertIcsiExempleToFannOutput(const string & exemple, IcsiboostNames & names);
+        // same conversions, written in <dest>
+        static void fillIcsiExempleFannInput(const string & exemple, IcsiboostNames & names, fann_type * dest);
+        static void fillIcsiExempleFannOutput(const string & exemple, IcsiboostNames & names, fann_type * dest);
+        // the inputs before the text buckets written in <dest>, the buckets set to 1 appended to <text> (numbered from the first text input)
+        static void fillIcsiExempleSparseInput(const string & exemple, IcsiboostNames & names, fann_type * dest, vector<unsigned int> & text);
+        // the examples are counted in SFANN_MEM_DATASETS before their allocation (--memory-limit) ;
+        // with text parameters, the input rows hold the buckets set to 1 after the other inputs (see SfannSparse::add_text)
         static struct fann_train_data * loadDataToFann(const string & file, IcsiboostNames & names) throw (SfannException);
+        // examples with text parameters, <bytes> already counted for their other inputs
+        static struct fann_train_data * loadTextDataToFann(const string & file, const vector<string> & lines, IcsiboostNames & names, unsigned long long bytes) throw (SfannException);
 };
 
 
@@ -131,6 +157,29 @@ class IcsiboostParameterContinuous : public IcsiboostParameterType {
         IcsiboostParameterContinuous();
         int getNeededNeurons() throw (SfannException);
         fann_type * convertToNeuralRepresentation(const string & icsi_data) throw (SfannException);
+        void fillNeuralRepresentation(const string & icsi_data, fann_type * dest) throw (SfannException);
+        string toString();
+};
+
+
+
+// Text parameter : bag of words (and of n-grams) hashed into a fixed number of
+// buckets, each bucket is one neuron set to 1 if one of its n-grams is present
+// and to -1 otherwise (so that the sparse first layer can skip the absent ones).
+// The data loader only keeps the buckets set to 1.
+class IcsiboostParameterText : public IcsiboostParameterType {
+
+    private:
+        int buckets;
+        int ngrams;
+
+    public:
+        IcsiboostParameterText(int buckets, int ngrams);
+        int getNeededNeurons() throw (SfannException);
+        fann_type * convertToNeuralRepresentation(const string & icsi_data) throw (SfannException);
+        void fillNeuralRepresentation(const string & icsi_data, fann_type * dest) throw (SfannException);
+        // buckets set to 1 by <icsi_data>, in increasing order, appended to <active> (plus <offset>)
+        void activeBuckets(const string & icsi_data, vector<unsigned int> & active, unsigned int offset);
         string toString();
 };
 
@@ -138,9 +187,13 @@ class IcsiboostParameterContinuous : public IcsiboostParameterType {
 
 class IcsiboostParameterFactory {
 	private:
+		static int text_buckets;
+		static int text_ngrams;
 
 	public:
 		static IcsiboostParameterType * createIcsiboostParameter(const string & icsi_def_line) throw (SfannException);
+		// hashing of the text parameters created afterwards
+		static void setTextHashing(int buckets, int ngrams);
 		static string stripString(const string & str, const char * sep);
 };
 
@@ -149,6 +202,9 @@ class IcsiboostUtils {
     public:
         static void tokenize(const string& str, vector<string>& tokens, const string& delimiters, bool strip_spaces);
         static void stripSpacePositions(const string& str, size_t & deb, size_t & fin);
+        // FNV-1a hash of <str>, continuing from <h> (to hash several strings as one)
+        static unsigned int hash(const string& str, unsigned int h = 2166136261u);
+        static unsigned int hash(const char * str, size_t len, unsigned int h = 2166136261u);
 };
 
 
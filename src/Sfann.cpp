@@ -44,6 +44,15 @@ Sfann::Sfann() {
     generic.add_options()
         ("help,h", "prints this help message")
         ("verbose,v", "verbose outputs")
+        ("perf-report", value<string>(), "write a JSON report of the time spent in each phase (parsing, loading, training, evaluation...) in the specified file")
+        ("memory-limit", value<int>(), "abort as soon as the data, folds, ANN snapshots and evaluation buffers would need more than <arg> MB")
+        ("log-format", value<string>(), "write every report and run result in --log-file, in csv or jsonl format")
+        ("log-file", value<string>(), "training log file (see --log-format)")
+        ("no-table", "do not print the table of the reports (with --verbose)")
+        ("threads", value<int>()->default_value(1), "number of threads (runs, cross-validation folds and fast leave-one-out trained at the same time)")
+        ("jobs-file", value<string>(), "instead of one action, run every experiment of <arg> (one per line : <name> <options>) on the data loaded once")
+        ("jobs-parallel", value<int>()->default_value(0), "number of --jobs-file experiments run at the same time (0: one per core)")
+        ("jobs-dir", value<string>()->default_value("."), "directory of the outputs (<name>.out) and of the summary (jobs.tsv) of the --jobs-file experiments")
         ;
 
     options_description actions("Action to be performed");
@@ -51,6 +60,7 @@ Sfann::Sfann() {
         ("do-cross-validation", "Perform a cross-validation on the train corpus")
         ("do-training", "train an ANN using the specified train/dev/test corpora")
         ("do-running", "run the specified ANN on the specified test corpus")
+        ("do-converting", "convert the ANN specified with --load-ann to --model-format and save it in --save-ann")
         ("do-nothing", "does not train ANN, only load data and generate corpora")
         ;
 
@@ -59,6 +69,7 @@ Sfann::Sfann() {
 // 		("num-input", value<int>(), "Size of the input layer")
 // 		("num-output", value<int>(), "Size of the output layer")
         ("num-hidden,l", value<int>(), "Size of the hidden layer")
+        ("model-format", value<string>()->default_value("text"), "format of the saved ANN: text (FANN format) or binary (memory-mappable)")
 /*        ("write-max-dev", value<string>(), "Write in the specified file, the MLP that obtain the best score on the dev corpus")
         ("write-max-train", value<string>(), "Write in the specified file, the MLP that obtain the best score on the train corpus")
         ("write-max-test", value<string>(), "Write in the specified file, the MLP that obtain the best score on the test corpus")*/
@@ -71,17 +82,33 @@ Sfann::Sfann() {
         ("dev,d", value<string>(), "data file containing the development documents (fann data format)")
         ("test,s", value<string>(), "data file containing the test documents (fann data format)")
         ("auto-dev,a", value<int>(), "automatically construct a dev corpus with <arg>% of the train")
+        ("text-buckets", value<int>()->default_value(1024), "number of hashed inputs of each Icsiboost text parameter (only the buckets set to 1 are stored)")
+        ("text-ngrams", value<int>()->default_value(1), "Icsiboost text parameters use the n-grams of 1 to <arg> words")
+        ("seed", value<unsigned int>(), "seed of the random choices (auto-dev...), taken from the clock if not given")
         ("save-dev", value<string>(), "save the automatically build development corpus")
+        ("collapse-duplicates", "merge the identical examples (same inputs and outputs) of the train into one example weighted by its number of copies (--do-training only, without --auto-dev or --save-dev)")
+        ("prune-inputs", "remove the inputs that are constant or duplicated in the train (unseen labels, missing values...) ; the kept inputs are saved in <model>.features and applied by --do-running")
+        ("stream-train", "read the --train file by blocks at each epoch instead of loading it (out-of-core training, dev and test stay in memory)")
+        ("stream-memory", value<int>()->default_value(64), "memory budget in MB of the --stream-train buffers")
         ;
 
     options_description training("General training options");
     training.add_options()
         ("randomize-data,r", "Randomize the order of the elements in the data vectors before training")
+        ("shuffle-mode", value<string>()->default_value("full"), "with --randomize-data, shuffle all the examples (full) or the order of blocks of examples and the examples inside each block (block)")
+        ("shuffle-block", value<int>(), "number of examples per block for --shuffle-mode block (default: about 256 KB of examples)")
+        ("input-encoding", value<string>()->default_value("auto"), "first layer computed on all the inputs (dense), only on the -1/1 inputs set to 1 (sparse), or sparse when it at least halves the work (auto)")
         ("clever-init,i", "Use the Widrow and Nguyen's algorithm for initialize weights")
         ("reports", value<int>()->default_value(100), "Number of epoch between reports")
         ("max-epoch", value<int>()->default_value(5000), "Max epoch")
         ("desired-error", value<float>()->default_value(0.001), "Desired error")
         ("num-runs,n", value<int>()->default_value(1), "Number of training/testing cycles for finding the ANN that perform the best on the Dev")
+        ("async-eval", "evaluate each report on a copy of the ANN in a background thread while the training goes on (--cancel-patience then stops a run one report later)")
+        ("cancel-patience", value<int>()->default_value(0), "stop a run when its dev classification rate has not improved for <arg> reports (0: never) ; each run is only compared with its own previous reports, so that the results do not depend on --threads")
+        ("cancel-behind", value<int>()->default_value(0), "stop a run when its best dev classification rate stays below that of the first run of its fold, at the same epoch, for <arg> reports in a row (0: never) ; the first run of each fold is trained before the other runs of the fold, so that the results do not depend on --threads")
+        ("trials-file", value<string>(), "train the --num-runs runs once per trial of <arg> (one per line : <name> <options of a run>, e.g. small -l 10 --max-epoch 500) ; the best networks are chosen among the runs of all the trials")
+        ("dev-sample", value<int>()->default_value(0), "evaluate the reports on a stratified sample of <arg> dev examples, the whole dev and test only when the sample improves, every --dev-full-every reports and at the last one (0: whole dev at every report)")
+        ("dev-full-every", value<int>()->default_value(10), "with --dev-sample, number of reports between two evaluations of the whole dev and test")
 //         ("-best-on", value<string>()->default_value("dev"), "The best ANN is the one that obtain the best results on the <arg> corpus, with <arg>=(dev|train|test)")
         ;
 
@@ -89,8 +116,11 @@ Sfann::Sfann() {
     cv_opts.add_options()
         ("cv-num-folds", value<int>()->default_value(10), "specify the number of folds (k-folds) for cross validating on the train corpus")
         ("cv-num-dev", value<int>()->default_value(1), "specify the number of folds used for the dev corpus")
-        ("cv-shuffle", "shuffle data before creating folds")
+        ("cv-shuffle", "shuffle the examples of each class (see --seed) before creating folds")
+        ("cv-repeats", value<int>()->default_value(1), "repeat the cross-validation with <arg> different fold splits (seeds --seed, --seed + 1...)")
         ("leave-one-out,o", "use leave-one-out validation on the train corpus")
+        ("loo-mode", value<string>()->default_value("exact"), "leave-one-out mode: exact (one ANN trained from scratch per example) or fast (approximation : each left-out example fine-tunes an ANN already trained on the whole train, including that example ; only the max-train line is reported)")
+        ("loo-fine-tune", value<int>()->default_value(10), "number of fine-tuning epochs for each left-out example in fast leave-one-out")
         ;
         
     options_description train_opts("Do-training specific options");
@@ -109,23 +139,55 @@ Sfann::Sfann() {
         ("save-loaded-run", value<string>(), "save the results on the test corpus of the ANN loaded with --load-ann")
         ;
 
+    options_description convert_opts("Do-converting specific options");
+    convert_opts.add_options()
+        ("save-ann", value<string>(), "save the ANN loaded with --load-ann in the specified file")
+        ;
+
     this->options = new options_description();
-    this->options->add(generic).add(actions).add(data).add(topology).add(training).add(cv_opts).add(train_opts).add(run_opts);
+    this->options->add(generic).add(actions).add(data).add(topology).add(training).add(cv_opts).add(train_opts).add(run_opts).add(convert_opts);
 
-    this->train_courant = NULL;
+    this->names = NULL;
 
     this->dev_data = NULL;
     this->test_data = NULL;
     this->train_data = NULL;
+    this->train_source = NULL;
+    this->stream = NULL;
+    this->features = NULL;
+    this->seed = 0;
 }
 
 
 Sfann::~Sfann() {
+    // une lecture en arriere-plan peut encore tourner si le programme s'arrete sur une erreur
+    try {
+        this->wait_data();
+    } catch (SfannException & e) {
+    }
+    delete this->names;
+    delete this->features;
     delete this->options;
     delete this->config;
-    if (this->train_data != NULL) fann_destroy_train(this->train_data);
-    if (this->test_data != NULL) fann_destroy_train(this->test_data);
-    if (this->dev_data != NULL) fann_destroy_train(this->dev_data);
+    if (this->stream != NULL) {
+        // train_data est l'en-tete du flux
+        SfannMemory::release(SFANN_MEM_DATASETS, this->stream->size());
+        delete this->stream;
+        this->train_data = NULL;
+    }
+    if (this->train_source != NULL) {
+        // train et dev sont des vues du train complet
+        SfannMemory::release(SFANN_MEM_DATASETS, view_size(this->train_source->num_data) + data_size(this->train_source));
+        delete_view(this->train_data);
+        delete_view(this->dev_data);
+        SfannWeights::forget(this->train_source);
+        SfannSparse::forget_text(this->train_source);
+        fann_destroy_train(this->train_source);
+    }
+    // taille comptee avec la colonne des poids et les compartiments texte : forget apres release
+    if (this->train_data != NULL) {SfannMemory::release(SFANN_MEM_DATASETS, data_size(this->train_data)); SfannWeights::forget(this->train_data); SfannSparse::forget_text(this->train_data); fann_destroy_train(this->train_data);}
+    if (this->test_data != NULL) {SfannMemory::release(SFANN_MEM_DATASETS, data_size(this->test_data)); SfannSparse::forget_text(this->test_data); fann_destroy_train(this->test_data);}
+    if (this->dev_data != NULL) {SfannMemory::release(SFANN_MEM_DATASETS, data_size(this->dev_data)); SfannSparse::forget_text(this->dev_data); fann_destroy_train(this->dev_data);}
 }
 
 
@@ -149,38 +211,347 @@ void Sfann::parse_config(int argc, char ** argv) throw (exception) {
     this->config = new variables_map();
     store(parse_command_line(argc, argv, *this->options), *this->config);
     notify(*this->config);
+    this->args.assign(argv + 1, argv + argc);
 }
 
-void Sfann::check_options() throw(SfannException) {
+variables_map * Sfann::job_config(const sfann_job & job) throw (SfannException) {
+    // options qui changeraient les donnees, chargees une seule fois pour toutes les experiences
+    static const char * shared[] = {"stem", "train", "dev", "test", "auto-dev", "save-dev", "text-buckets", "text-ngrams",
+                                    "stream-train", "stream-memory", "collapse-duplicates", "prune-inputs", "memory-limit", "jobs-file", "jobs-parallel", "jobs-dir", "help", NULL};
+
+    // fichiers propres a chaque experience, jamais repris de la ligne de commande
+    static const char * own[] = {"perf-report", "log-format", "log-file", NULL};
+
+    variables_map * vm = new variables_map();
+    set<string> given;
+    try {
+        parsed_options parsed = command_line_parser(job.args).options(*this->options).run();
+        for (size_t i=0; i<parsed.options.size(); i++) {
+            given.insert(parsed.options[i].string_key);
+            for (int k=0; shared[k] != NULL; k++) {
+                if (parsed.options[i].string_key == shared[k]) {
+                    throw SfannException(string("option --") + shared[k] + " is shared by all the experiments and can only be given on the command line");
+                }
+            }
+        }
+        // les premieres valeurs enregistrees sont gardees : celles de l'experience l'emportent
+        store(parsed, *vm);
+        store(command_line_parser(this->args).options(*this->options).run(), *vm);
+        notify(*vm);
+    } catch (exception & e) {
+        delete vm;
+        ostringstream oss;
+        oss << "Experiment " << job.name << " (line " << job.line << ") : " << e.what();
+        throw SfannException(oss.str());
+    }
+    vm->erase("jobs-file");
+    for (int k=0; own[k] != NULL; k++) {
+        if (!given.count(own[k])) vm->erase(own[k]);
+    }
+    return vm;
+}
+
+int Sfann::run_job(const sfann_job & job) {
+    Sfann * me = Sfann::me;
+    variables_map * config = NULL;
+    int status = 0;
+    try {
+        // les options de la ligne de commande (me->config) restent celles du chargement
+        config = me->job_config(job);
+        me->check_options(*config);
+        cout << "-> Experiment " << job.name << endl;
+        me->do_training(*config);
+        me->write_perf_report(*config);
+    } catch (exception & e) {
+        cerr << "Error in experiment " << job.name << " : " << e.what() << "\n";
+        status = 1;
+    }
+    delete config;
+    return status;
+}
 
-    bool nothing = this->config->count("do-nothing");
-    bool cross_validate = this->config->count("do-cross-validation");
-    bool training = this->config->count("do-training");
-    bool running = this->config->count("do-running");
+void Sfann::check_options() throw (SfannException) {
+    this->check_options(*this->config);
+
+    // graine du chargement (--auto-dev) ; une experience de --jobs-file peut avoir la sienne (seed_of)
+    if (this->config->count("seed")) {
+        this->seed = (*this->config)["seed"].as<unsigned int>();
+    } else {
+        this->seed = (unsigned int)time(0);
+    }
+    this->rng.set_seed(this->seed);
+
+    if (this->config->count("memory-limit")) {
+        SfannMemory::set_limit((unsigned long long)(*this->config)["memory-limit"].as<int>() * 1024 * 1024);
+    }
+}
+
+unsigned int Sfann::seed_of(const variables_map & config) {
+    return config.count("seed") ? config["seed"].as<unsigned int>() : this->seed;
+}
+
+void Sfann::check_options(const variables_map & config) throw (SfannException) {
+
+    bool nothing = config.count("do-nothing");
+    bool cross_validate = config.count("do-cross-validation");
+    bool training = config.count("do-training");
+    bool running = config.count("do-running");
+    bool converting = config.count("do-converting");
     
-    if (this->config->count("help")) {
+    if (config.count("help")) {
         throw *new SfannException("Help required");
     }
 
-    if (this->config->count("dev") && this->config->count("auto-dev")) {
+    bool jobs = config.count("jobs-file");
+    if (jobs) {
+        if (nothing || cross_validate || training || running || converting) {
+            throw *new SfannException("With --jobs-file, the action is given by each experiment");
+        }
+        if (config.count("stream-train")) {
+            throw *new SfannException("Incompatible options : --jobs-file and --stream-train");
+        }
+        if (config["jobs-parallel"].as<int>() < 0) {
+            throw *new SfannException("The number of parallel experiments can not be negative");
+        }
+        if (this->jobs.empty()) {
+            SfannJobs::read(config["jobs-file"].as<string>(), this->jobs);
+        }
+
+        // toutes les experiences sont verifiees avant le chargement des donnees
+        for (size_t j=0; j<this->jobs.size(); j++) {
+            variables_map * job = this->job_config(this->jobs[j]);
+            try {
+                this->check_options(*job);
+            } catch (exception & e) {
+                delete job;
+                ostringstream oss;
+                oss << "Experiment " << this->jobs[j].name << " (line " << this->jobs[j].line << ") : " << e.what();
+                throw *new SfannException(oss.str());
+            }
+            delete job;
+        }
+    }
+
+    if (config.count("dev") && config.count("auto-dev")) {
         throw *new SfannException("Incompatible options : --dev and --auto-dev");
     }
 
-    if ((training || cross_validate) && (!this->config->count("train") && !this->config->count("stem"))) {
+    if ((training || cross_validate) && (!config.count("train") && !config.count("stem"))) {
         throw *new SfannException("You have to specify a training corpus (with --train or --stem)");
     }
 
-    if (this->config->count("do-running") + this->config->count("do-nothing") + this->config->count("do-training") + this->config->count("do-cross-validation") != 1) {
+    if (!jobs && config.count("do-running") + config.count("do-nothing") + config.count("do-training") + config.count("do-cross-validation") + config.count("do-converting") != 1) {
         throw *new SfannException("You have to specify (only) one action to be performed");
     }
 
-    if (running && (!this->config->count("load-ann") || !this->config->count("test"))) {
+    if (running && (!config.count("load-ann") || !config.count("test"))) {
         throw *new SfannException("You have to specify an ANN (with --load-ann) to run and a test corpus (with --test)");
     }
 
-    if (training && (!this->config->count("num-hidden") || !this->config->count("num-runs") || !this->config->count("max-epoch") || !this->config->count("reports") || !this->config->count("desired-error"))) {
+    if (converting && (!config.count("load-ann") || !config.count("save-ann"))) {
+        throw *new SfannException("You have to specify an ANN to convert (with --load-ann) and its destination (with --save-ann)");
+    }
+
+    string model_format = config["model-format"].as<string>();
+    if (model_format != "text" && model_format != "binary") {
+        throw *new SfannException("Unknown model format : " + model_format + " (text or binary expected)");
+    }
+
+    if (config.count("log-format") != config.count("log-file")) {
+        throw *new SfannException("Options --log-format and --log-file have to be used together");
+    }
+
+    if (config.count("log-format")) {
+        string log_format = config["log-format"].as<string>();
+        if (log_format != "csv" && log_format != "jsonl") {
+            throw *new SfannException("Unknown log format : " + log_format + " (csv or jsonl expected)");
+        }
+    }
+
+    string shuffle_mode = config["shuffle-mode"].as<string>();
+    if (shuffle_mode != "full" && shuffle_mode != "block") {
+        throw *new SfannException("Unknown shuffle mode : " + shuffle_mode + " (full or block expected)");
+    }
+    if (config.count("shuffle-block") && config["shuffle-block"].as<int>() < 1) {
+        throw *new SfannException("The shuffle block size must be at least 1");
+    }
+
+    if (config["text-buckets"].as<int>() < 1 || config["text-ngrams"].as<int>() < 1) {
+        throw *new SfannException("The number of text buckets and the n-gram length must be at least 1");
+    }
+
+    if (config.count("collapse-duplicates")) {
+        // les folds de la validation croisee separeraient les exemples par vecteur distinct
+        if (!training && !jobs) {
+            throw *new SfannException("Option --collapse-duplicates needs --do-training");
+        }
+        if (config.count("stream-train")) {
+            throw *new SfannException("Option --collapse-duplicates can not be used with --stream-train");
+        }
+        // le dev serait tire par vecteur distinct, et fann_save_train perdrait les poids
+        if (config.count("auto-dev") || config.count("save-dev")) {
+            throw *new SfannException("Option --collapse-duplicates can not be used with --auto-dev or --save-dev");
+        }
+    }
+
+    if (config.count("prune-inputs")) {
+        if (config.count("stream-train")) {
+            throw *new SfannException("Option --prune-inputs can not be used with --stream-train");
+        }
+        // le dev sauve n'aurait plus les entrees du format d'origine
+        if (config.count("save-dev")) {
+            throw *new SfannException("Option --prune-inputs can not be used with --save-dev");
+        }
+    }
+
+    if (config.count("stream-train")) {
+        if (!training || !config.count("train")) {
+            throw *new SfannException("Option --stream-train needs --do-training and a --train file");
+        }
+        if (config.count("auto-dev") || config.count("clever-init") || config.count("randomize-data")) {
+            throw *new SfannException("Option --stream-train can not be used with --auto-dev, --clever-init or --randomize-data");
+        }
+        if (config["stream-memory"].as<int>() <= 0) {
+            throw *new SfannException("The stream memory budget must be a positive number of MB");
+        }
+    }
+
+    string input_encoding = config["input-encoding"].as<string>();
+    if (input_encoding != "auto" && input_encoding != "dense" && input_encoding != "sparse") {
+        throw *new SfannException("Unknown input encoding : " + input_encoding + " (auto, dense or sparse expected)");
+    }
+
+    if (config["threads"].as<int>() < 1) {
+        throw *new SfannException("The number of threads must be at least 1");
+    }
+
+    if (config["dev-sample"].as<int>() < 0) {
+        throw *new SfannException("The dev sample size must be positive or 0");
+    }
+
+    if (config["dev-full-every"].as<int>() < 1) {
+        throw *new SfannException("The interval between full dev evaluations must be at least 1 report");
+    }
+
+    if (config["cancel-patience"].as<int>() < 0) {
+        throw *new SfannException("The cancel patience must be positive or 0");
+    }
+
+    string loo_mode = config["loo-mode"].as<string>();
+    if (loo_mode != "fast" && loo_mode != "exact") {
+        throw *new SfannException("Unknown leave-one-out mode : " + loo_mode + " (fast or exact expected)");
+    }
+    if (config["loo-fine-tune"].as<int>() < 0) {
+        throw *new SfannException("The number of fine-tuning epochs can not be negative");
+    }
+
+    if (cross_validate && config["cv-repeats"].as<int>() < 1) {
+        throw *new SfannException("The number of cross-validation repetitions must be at least 1");
+    }
+
+    if (config.count("memory-limit") && config["memory-limit"].as<int>() <= 0) {
+        throw *new SfannException("The memory limit must be a positive number of MB");
+    }
+
+    if (training && (!config.count("num-hidden") || !config.count("num-runs") || !config.count("max-epoch") || !config.count("reports") || !config.count("desired-error"))) {
         throw *new SfannException("You have to specify more options for training ANN (--num-hidden missing ?)");
     }
+
+    if (config["cancel-behind"].as<int>() < 0) {
+        throw *new SfannException("The number of reports behind the first run can not be negative");
+    }
+
+    // avec --jobs-file, les essais sont verifies avec chaque experience
+    if (config.count("trials-file") && !jobs) {
+        if (!training && !cross_validate) {
+            throw *new SfannException("Option --trials-file is only used by --do-training and --do-cross-validation");
+        }
+        if (config.count("leave-one-out") && config["loo-mode"].as<string>() == "fast") {
+            throw *new SfannException("Incompatible options : --trials-file and --loo-mode fast");
+        }
+        vector<sfann_job> trials;
+        vector<variables_map *> configs;
+        this->read_trials(config, trials, configs);
+        string error;
+        for (size_t k=0; k<configs.size() && error.empty(); k++) {
+            try {
+                this->check_options(*configs[k]);
+            } catch (exception & e) {
+                ostringstream oss;
+                oss << "Trial " << trials[k].name << " (line " << trials[k].line << ") : " << e.what();
+                error = oss.str();
+            }
+        }
+        for (size_t k=0; k<configs.size(); k++) delete configs[k];
+        if (!error.empty()) {
+            throw *new SfannException(error);
+        }
+    }
+
+    this->check_text_options(config);
+}
+
+void Sfann::check_text_options(const variables_map & config) throw (SfannException) {
+    // schema pas encore lu, ou sans parametre texte
+    if (this->names == NULL || this->names->getTextNeurons() == 0) return;
+
+    if (config["input-encoding"].as<string>() == "dense") {
+        throw *new SfannException("The text parameters are only stored sparsely : --input-encoding dense is not possible");
+    }
+    // ces traitements lisent ou ecrivent les entrees denses de chaque exemple
+    if (config.count("prune-inputs") || config.count("collapse-duplicates") || config.count("save-dev") || config.count("clever-init")) {
+        throw *new SfannException("Options --prune-inputs, --collapse-duplicates, --save-dev and --clever-init can not be used with text parameters");
+    }
+    if (config.count("leave-one-out") && config["loo-mode"].as<string>() == "fast") {
+        throw *new SfannException("Option --loo-mode fast can not be used with text parameters");
+    }
+}
+
+void Sfann::read_trials(const variables_map & config, vector<sfann_job> & trials, vector<variables_map *> & configs) throw (SfannException) {
+    // les seules options qu'un essai peut changer : celles d'un run
+    static const char * run_options[] = {"num-hidden", "max-epoch", "reports", "desired-error", "clever-init", "randomize-data",
+                                         "shuffle-mode", "shuffle-block", "input-encoding", "cancel-patience", "seed", NULL};
+
+    trials.clear();
+    configs.clear();
+    if (!config.count("trials-file")) {
+        configs.push_back(new variables_map(config));
+        return;
+    }
+
+    SfannJobs::read(config["trials-file"].as<string>(), trials);
+    for (size_t k=0; k<trials.size(); k++) {
+        variables_map * vm = new variables_map();
+        try {
+            parsed_options parsed = command_line_parser(trials[k].args).options(*this->options).run();
+            for (size_t i=0; i<parsed.options.size(); i++) {
+                bool allowed = false;
+                for (int o=0; run_options[o] != NULL; o++) {
+                    if (parsed.options[i].string_key == run_options[o]) allowed = true;
+                }
+                if (!allowed) {
+                    throw SfannException("option --" + parsed.options[i].string_key + " is not an option of a run");
+                }
+            }
+            store(parsed, *vm);
+            // les autres options, et celles que l'essai ne donne pas, sont celles de l'experience
+            for (variables_map::const_iterator it = config.begin(); it != config.end(); ++it) {
+                if (!vm->count(it->first) || (*vm)[it->first].defaulted()) {
+                    ((map<string, variable_value> &)*vm)[it->first] = it->second;
+                }
+            }
+            notify(*vm);
+        } catch (exception & e) {
+            delete vm;
+            for (size_t c=0; c<configs.size(); c++) delete configs[c];
+            configs.clear();
+            ostringstream oss;
+            oss << "Trial " << trials[k].name << " (line " << trials[k].line << ") : " << e.what();
+            throw SfannException(oss.str());
+        }
+        vm->erase("trials-file");
+        configs.push_back(vm);
+    }
 }
 
 void Sfann::usage() {
@@ -193,6 +564,196 @@ bool Sfann::is_readable(const string & file) {
         return !f.fail();
 }
 
+unsigned long long Sfann::file_size(const string & file) {
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) return 0;
+    return st.st_size;
+}
+
+unsigned long long Sfann::data_size(const struct fann_train_data * data) {
+    if (data == NULL) return 0;
+    // les compartiments texte a 1 sont ranges apres les entrees (SfannSparse::add_text)
+    return data_size(data, data->num_data) + SfannSparse::text_values(data) * sizeof(fann_type);
+}
+
+unsigned long long Sfann::data_size(const struct fann_train_data * model, unsigned int num_data) {
+    // un corpus pondere (--collapse-duplicates) range le poids apres les entrees
+    unsigned int num_weights = SfannWeights::weighted(model) ? 1 : 0;
+    return SfannMemory::data_size(num_data, model->num_input + num_weights, model->num_output);
+}
+
+unsigned long long Sfann::view_size(unsigned int num_data) {
+    return (unsigned long long)num_data * 2 * sizeof(fann_type *);
+}
+
+unsigned long long Sfann::matrix_size(int x, int y) {
+    if (x <= 0) return 0;
+    return (unsigned long long)x * (y * sizeof(fann_type) + sizeof(fann_type *));
+}
+
+unsigned long long Sfann::net_size(const struct fann * net) {
+    if (net == NULL) return 0;
+    return net->total_neurons * (sizeof(struct fann_neuron) + sizeof(fann_type))
+            + net->total_connections_allocated * (sizeof(fann_type) + sizeof(struct fann_neuron *)
+            + ((net->train_slopes != NULL) + (net->prev_steps != NULL) + (net->prev_train_slopes != NULL) + (net->prev_weights_deltas != NULL)) * sizeof(fann_type));
+}
+
+unsigned long long Sfann::copy_size(const struct fann * net) {
+    if (net == NULL) return 0;
+    return net->total_neurons * (sizeof(struct fann_neuron) + sizeof(fann_type))
+            + net->total_connections * (sizeof(fann_type) + sizeof(struct fann_neuron *)
+            + ((net->train_slopes != NULL) + (net->prev_steps != NULL) + (net->prev_train_slopes != NULL) + (net->prev_weights_deltas != NULL)) * sizeof(fann_type));
+}
+
+unsigned long long Sfann::snapshot_size(training_context * ctx, const struct fann * ann, bool dev, bool test) {
+    unsigned long long size = copy_size(ann);
+    if (dev) size += matrix_size(ctx->dev->num_data, ctx->dev->num_output);
+    if (test) size += matrix_size(ctx->test->num_data, ctx->test->num_output);
+    return size;
+}
+
+struct fann * Sfann::snapshot_copy(const struct fann * ann, unsigned long long reserved) throw (SfannException) {
+    struct fann * copy = fann_copy(ann);
+    if (copy == NULL) {
+        SfannMemory::release(SFANN_MEM_SNAPSHOTS, reserved);
+        throw SfannException("Impossible allocation of an ANN snapshot !");
+    }
+    return copy;
+}
+
+unsigned long long Sfann::net_carac_size(const net_carac * nc) {
+    if (nc == NULL) return 0;
+    unsigned long long size = net_size(nc->net);
+    if (nc->dev_out != NULL) size += matrix_size(nc->dev_num_data, nc->dev_num_output);
+    if (nc->test_out != NULL) size += matrix_size(nc->test_num_data, nc->test_num_output);
+    return size;
+}
+
+string Sfann::format_duration(double seconds) {
+    if (seconds < 0) seconds = 0;
+    long s = (long)(seconds + 0.5);
+    char buf[32];
+    sprintf(buf, "%ld:%02ld:%02ld", s / 3600, (s / 60) % 60, s % 60);
+    return string(buf);
+}
+
+// lit un fichier de donnees (format Icsiboost si <names> est donne, format FANN sinon) en mesurant le temps de lecture
+struct fann_train_data * Sfann::read_data_file(const string & file, IcsiboostNames * names, const string & phase) throw (SfannException) {
+    SfannPerfScope perf(phase);
+    perf.add_bytes_read(file_size(file));
+
+    cout << " ->  Reading " << file << " ...";
+    struct fann_train_data * data = parse_data_file(file, names);
+    cout << " Ok ! (" << data->num_data << " examples)" << endl;
+
+    // deja compte par le lecteur, avant l'allocation
+    perf.add_items(data->num_data);
+    perf.add_bytes_allocated(data_size(data));
+    return data;
+}
+
+struct fann_train_data * Sfann::parse_data_file(const string & file, IcsiboostNames * names) throw (SfannException) {
+    struct fann_train_data * data = NULL;
+    if (names != NULL) {
+        data = IcsiboostDataParser::loadDataToFann(file, *names);
+    } else {
+        data = SfannParse::read_fann_file(file);
+    }
+    if (data == NULL) {
+        throw SfannException("Impossible read of " + file + " !");
+    }
+    return data;
+}
+
+void * Sfann::load_worker(void * arg) {
+    data_load * load = (data_load *)arg;
+    double start = SfannPerf::now();
+    try {
+        load->data = parse_data_file(load->file, load->names);
+    } catch (SfannException & e) {
+        load->error = e.what();
+    } catch (bad_alloc & e) {
+        load->error = "Impossible allocation of the examples of " + load->file + " !";
+    }
+    load->seconds = SfannPerf::now() - start;
+    return NULL;
+}
+
+void Sfann::start_load(const string & file, const string & phase, struct fann_train_data ** target) {
+    data_load * load = new data_load;
+    load->file = file;
+    load->names = this->names;
+    load->phase = phase;
+    load->target = target;
+    load->data = NULL;
+    load->seconds = 0;
+    load->threaded = pthread_create(&load->thread, NULL, load_worker, load) == 0;
+    if (!load->threaded) {
+        // pas de thread disponible : lecture immediate
+        load_worker(load);
+    }
+    cout << " ->  Reading " << file << " in background ..." << endl;
+    this->loads.push_back(load);
+}
+
+void Sfann::save_model(struct fann * net, const string & file, bool binary) throw (SfannException) {
+    SfannModel::save(net, file, binary);
+    // sans --prune-inputs, la projection d'un ancien modele du meme nom n'a plus cours
+    if (this->features != NULL) {
+        SfannFeatures::save(*this->features, SfannFeatures::file_of(file));
+    } else {
+        remove(SfannFeatures::file_of(file).c_str());
+    }
+}
+
+struct fann_train_data * Sfann::project_data(const struct fann_train_data * data, const feature_map & map) throw (SfannException) {
+    unsigned long long bytes = SfannMemory::data_size(data->num_data, map.kept.size(), data->num_output);
+    SfannMemory::allocate(SFANN_MEM_DATASETS, bytes);
+    try {
+        return SfannFeatures::project(data, map);
+    } catch (SfannException & e) {
+        SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+        throw;
+    }
+}
+
+void Sfann::wait_data() throw (SfannException) {
+    string error;
+    for (size_t i=0; i<this->loads.size(); i++) {
+        data_load * load = this->loads[i];
+        if (load->threaded) pthread_join(load->thread, NULL);
+
+        // meme projection que le train (--prune-inputs)
+        if (load->data != NULL && this->features != NULL) {
+            try {
+                struct fann_train_data * projected = project_data(load->data, *this->features);
+                SfannMemory::release(SFANN_MEM_DATASETS, data_size(load->data));
+                fann_destroy_train(load->data);
+                load->data = projected;
+            } catch (SfannException & e) {
+                load->error = load->file + " : " + e.what();
+                SfannMemory::release(SFANN_MEM_DATASETS, data_size(load->data));
+                fann_destroy_train(load->data);
+                load->data = NULL;
+            }
+        }
+
+        // la memoire du corpus a ete comptee par le lecteur, avant son allocation
+        if (load->data != NULL) {
+            *load->target = load->data;
+            SfannPerf::record(load->phase, load->seconds, load->data->num_data, file_size(load->file), data_size(load->data));
+            cout << " ->  Read " << load->file << " : Ok ! (" << load->data->num_data << " examples, " << load->seconds << " s)" << endl;
+        } else if (error.empty()) {
+            error = load->error;
+        }
+        delete load;
+    }
+    this->loads.clear();
+    if (!error.empty()) {
+        throw SfannException(error);
+    }
+}
+
 void Sfann::load_data() throw (SfannException) {
     if ((*this->config).count("stem")) {
         string stem = (*this->config)["stem"].as<string>();
@@ -201,40 +762,31 @@ void Sfann::load_data() throw (SfannException) {
             throw SfannException("File "+stem+".names needed but not present or not readable !");
         }
         cout << " ->  Reading " << stem << ".names ...";
-        IcsiboostNames names(stem+".names");
+        SfannPerfScope perf_names("parse.names");
+        IcsiboostParameterFactory::setTextHashing((*this->config)["text-buckets"].as<int>(), (*this->config)["text-ngrams"].as<int>());
+        this->names = new IcsiboostNames(stem+".names");
+        perf_names.add_bytes_read(file_size(stem+".names"));
+        perf_names.stop();
         cout << " Ok !" << endl;
 
-        if (is_readable(stem+".data")) {
-            cout << " ->  Reading " << stem << ".data ...";
-            this->train_data = IcsiboostDataParser::loadDataToFann(stem+".data", names);
-            cout << " Ok ! (" << this->train_data->num_data << " examples)" << endl;
-        }
-        
+        // options verifiees de nouveau avec le schema (parametres texte)
+        this->check_options(*this->config);
+
+        // le test et le dev sont lus pendant le train, avec le meme schema
         if (is_readable(stem+".test")) {
-            cout << " ->  Reading " << stem << ".test ...";
-            this->test_data = IcsiboostDataParser::loadDataToFann(stem+".test", names);
-            cout << " Ok ! (" << this->test_data->num_data << " examples)" << endl;
+            this->start_load(stem+".test", "load.test", &this->test_data);
         }
 
         if (is_readable(stem+".dev")) {
-            cout << " ->  Reading " << stem << ".dev ...";
-            this->dev_data = IcsiboostDataParser::loadDataToFann(stem+".dev", names);
-            cout << " Ok ! (" << this->dev_data->num_data << " examples)" << endl;
+            this->start_load(stem+".dev", "load.dev", &this->dev_data);
         }
-        
-    } else {
-        if ((*this->config).count("train")) {
-            string train = (*this->config)["train"].as<string>();
 
-            if (!is_readable(train)) {
-                throw SfannException("File "+train+" is not present or not readable !");
-            }
-        
-            cout << " ->  Reading " << train << " ...";
-            this->train_data = fann_read_train_from_file(train.c_str());
-            cout << " Ok ! (" << this->train_data->num_data << " examples)" << endl;
+        if (is_readable(stem+".data")) {
+            this->train_data = read_data_file(stem+".data", this->names, "load.train");
         }
-
+        
+    } else {
+        // le test et le dev sont lus pendant le train
         if ((*this->config).count("test")) {
             string test = (*this->config)["test"].as<string>();
 
@@ -242,9 +794,7 @@ void Sfann::load_data() throw (SfannException) {
                 throw SfannException("File "+test+" is not present or not readable !");
             }
 
-            cout << " ->  Reading " << test << " ...";
-            this->test_data = fann_read_train_from_file(test.c_str());
-            cout << " Ok ! (" << this->test_data->num_data << " examples)" << endl;
+            this->start_load(test, "load.test", &this->test_data);
         }
 
         if ((*this->config).count("dev")) {
@@ -254,15 +804,70 @@ void Sfann::load_data() throw (SfannException) {
                 throw SfannException("File "+dev+" is not present or not readable !");
             }
 
-            cout << " ->  Reading " << dev << " ...";
-            this->dev_data = fann_read_train_from_file(dev.c_str());
-            cout << " Ok ! (" << this->dev_data->num_data << " examples)" << endl;
+            this->start_load(dev, "load.dev", &this->dev_data);
         }
+
+        if ((*this->config).count("train")) {
+            string train = (*this->config)["train"].as<string>();
+
+            if (!is_readable(train)) {
+                throw SfannException("File "+train+" is not present or not readable !");
+            }
+        
+            if ((*this->config).count("stream-train")) {
+                SfannPerfScope perf("stream.open");
+                this->stream = new SfannStream(train, (unsigned long long)(*this->config)["stream-memory"].as<int>() * 1024 * 1024);
+                SfannMemory::allocate(SFANN_MEM_DATASETS, this->stream->size());
+                perf.add_bytes_allocated(this->stream->size());
+                this->train_data = this->stream->header();
+                cout << " ->  Streaming " << train << " (" << this->train_data->num_data << " examples, by blocks of " << this->stream->get_block_size() << ")" << endl;
+            } else {
+                this->train_data = read_data_file(train, NULL, "load.train");
+            }
+        }
+    }
+
+    // entrees constantes ou en double retirees du train ; le dev et le test le seront a la fin de leur lecture
+    if ((*this->config).count("prune-inputs") && this->train_data != NULL) {
+        SfannPerfScope perf("prune.inputs");
+        unsigned int num_constant, num_duplicate;
+        this->features = new feature_map(SfannFeatures::analyze(this->train_data, num_constant, num_duplicate));
+        struct fann_train_data * projected = project_data(this->train_data, *this->features);
+        perf.add_items(this->train_data->num_data);
+        perf.add_bytes_allocated(data_size(projected));
+        cout << " ->  Inputs pruned : " << projected->num_input << " of the " << this->train_data->num_input << " inputs kept ("
+             << num_constant << " constant, " << num_duplicate << " duplicated)" << endl;
+        SfannMemory::release(SFANN_MEM_DATASETS, data_size(this->train_data));
+        fann_destroy_train(this->train_data);
+        this->train_data = projected;
+    }
+
+    // un exemple par vecteur distinct, de poids son nombre de copies (jamais avec --auto-dev, voir check_options)
+    if ((*this->config).count("collapse-duplicates") && this->train_data != NULL) {
+        SfannPerfScope perf("collapse.train");
+        struct fann_train_data * collapsed = SfannWeights::collapse(this->train_data);
+        SfannMemory::allocate(SFANN_MEM_DATASETS, data_size(collapsed));
+        perf.add_items(this->train_data->num_data);
+        perf.add_bytes_allocated(data_size(collapsed));
+        cout << " ->  Duplicates collapsed : " << collapsed->num_data << " distinct examples in the " << this->train_data->num_data << " of the train" << endl;
+        SfannMemory::release(SFANN_MEM_DATASETS, data_size(this->train_data));
+        fann_destroy_train(this->train_data);
+        this->train_data = collapsed;
+    }
+
+    // ces traitements ont besoin du dev et du test tout de suite
+    if ((*this->config).count("auto-dev") || (*this->config).count("save-dev")) {
+        this->wait_data();
     }
     
     if ((*this->config).count("auto-dev")) {
-        if (this->dev_data != NULL) {delete this->dev_data; this->dev_data = NULL;}
-        create_dev_from_train_corpus(this->dev_data, this->train_data, this->test_data, (*this->config)["auto-dev"].as<int>());
+        if (this->dev_data != NULL) {SfannMemory::release(SFANN_MEM_DATASETS, data_size(this->dev_data)); delete this->dev_data; this->dev_data = NULL;}
+        SfannPerfScope perf("split.auto-dev");
+        cout << " ->  Random seed : " << this->seed << endl;
+        this->train_source = this->train_data;
+        create_dev_from_train_corpus(this->dev_data, this->train_data, this->test_data, (*this->config)["auto-dev"].as<int>(), this->rng);
+        if (this->train_data == this->train_source) this->train_source = NULL;
+        if (this->dev_data != NULL) perf.add_items(this->dev_data->num_data + this->train_data->num_data);
     }
 
     if ((*this->config).count("save-dev")) {
@@ -295,8 +900,9 @@ void Sfann::print_fann_train_data(struct fann_train_data * data) {
     }
 }
 
-// Extrait un corpus de dev des donnes de train en choisissant aleatoirement les exemples mais en en conservant la meme proportion que dans le test ; si _test_data est NULL alors la proportion du train sera gardee.
-void Sfann::create_dev_from_train_corpus(struct fann_train_data * & _dev_data, struct fann_train_data * & _train_data, const struct fann_train_data * _test_data, int dev_size) throw (SfannException) {
+// Extrait un corpus de dev des donnees de train en choisissant aleatoirement les exemples mais en en conservant la meme proportion que dans le test ; si _test_data est NULL alors la proportion du train sera gardee.
+// Les exemples ne sont pas copies : _train_data est remplace par une vue de l'ancien train (que l'appelant doit conserver) et _dev_data est une vue.
+void Sfann::create_dev_from_train_corpus(struct fann_train_data * & _dev_data, struct fann_train_data * & _train_data, const struct fann_train_data * _test_data, int dev_size, SfannRandom & rng) throw (SfannException) {
     if (dev_size > 50) dev_size = 50;
     if (dev_size < 0) dev_size = 0;
 
@@ -309,17 +915,25 @@ void Sfann::create_dev_from_train_corpus(struct fann_train_data * & _dev_data, s
     int taille_test = 0;
     if (_test_data != NULL) {
         taille_test = _test_data->num_data;
+        vector<int> nb_test(_test_data->num_output, 0);
         for (int i=0; i<taille_test; i++) {
-            ++composition_test[max_struct(_test_data->output[i], _test_data->num_output)];
+            ++nb_test[max_struct(_test_data->output[i], _test_data->num_output)];
+        }
+        for (size_t c=0; c<nb_test.size(); c++) {
+            if (nb_test[c] > 0) composition_test[c] = nb_test[c];
         }
     }
 
-    // parcours le train pour connaitre sa composition (proportion de chaque classe)
+    // range les indices du train par classe, en une seule passe
+    vector< vector<unsigned int> > by_class;
+    class_index(_train_data, by_class);
+
+    // composition du train (proportion de chaque classe)
     // pour verifier qu'il y a bien au moins le nombre d'elements qu'on veut pour le dev
     map<int, int> composition_train;
     int taille_train = _train_data->num_data;
-    for (int i=0; i<taille_train; i++) {
-        ++composition_train[max_struct(_train_data->output[i], _train_data->num_output)];
+    for (size_t c=0; c<by_class.size(); c++) {
+        if (!by_class[c].empty()) composition_train[c] = by_class[c].size();
     }
 
     int taille_dev = _train_data->num_data * dev_size / 100;
@@ -351,6 +965,11 @@ void Sfann::create_dev_from_train_corpus(struct fann_train_data * & _dev_data, s
     // ajout des elements manquants en piochant dans la classe dominante
     int max_classe = max_struct(composition_train);
     composition_dev[max_classe] += taille_dev - taille_dev_actuelle;
+    if (composition_dev[max_classe] > composition_train[max_classe]) {
+        // la classe dominante ne suffit pas
+        taille_dev -= composition_dev[max_classe] - composition_train[max_classe];
+        composition_dev[max_classe] = composition_train[max_classe];
+    }
 
     cout << "Building dev corpus with " << taille_dev << " randomly choosen exemples in the " << _train_data->num_data << " exemples from the train corpus (" << dev_size << "%).\n";
 
@@ -363,59 +982,102 @@ void Sfann::create_dev_from_train_corpus(struct fann_train_data * & _dev_data, s
     cout << "Dev content (" << dev_size << "%) :\n";
     print_map(composition_dev);
 
-    // On alloue l'espace pour mettre le train moins le dev (le nouveau train)
-    struct fann_train_data * new_train_data = new struct fann_train_data;
-    init_structure_metadata(_train_data, new_train_data, taille_train-taille_dev);
-
-    // On alloue l'espace pour mettre le dev
-    _dev_data = new struct fann_train_data;
-    init_structure_metadata(_train_data, _dev_data, taille_dev);
-
-    // On choisit aleatoirement des indices du train, on ajoute l'exemple dans le dev si il est pas deja
-    // ajoute, et si on a encore besoin d'exemple de cette classe
-    set<int> deja;
-    srand((unsigned)time(0));
-    while (_dev_data->num_data < taille_dev) {
-        int i = (rand()/(double)RAND_MAX)*(taille_train-1);
-        // si on a pas deja vu cet exemple,
-        if (deja.count(i) == 0) {
-            int classe = max_struct(_train_data->output[i], _train_data->num_output);
-            // et si on a encore besoin d'un exemple de cette classe
-            if (composition_dev[classe] > 0) {
-                // on copie l'exemple i dans le dev
-                copy_train_data(_train_data, _dev_data, i, 1);
-                deja.insert(i);
-                composition_dev[classe]--;
-            }
+    // tirage sans remise dans chaque classe : les composition_dev[c] premiers indices de la classe c vont dans le dev
+    vector<bool> in_dev(taille_train, false);
+    for (map<int,int>::iterator it=composition_dev.begin(); it != composition_dev.end(); ++it) {
+        if (it->second <= 0 || it->first >= (int)by_class.size()) continue;
+        vector<unsigned int> & indices = by_class[it->first];
+        rng.partial_shuffle(indices, it->second);
+        for (int k=0; k<it->second && k<(int)indices.size(); k++) {
+            in_dev[indices[k]] = true;
         }
     }
 
-    // On remplit le nouveau train avec ce qui n'a pas ete mis dans le dev
-    int pos = 0;
-    int total = 0;
-    for (set<int>::iterator it = deja.begin(); it != deja.end(); ++it) {
-        if ((*it) != pos) {
-            // cerr << (*it) << " -> copie " << (*it)-pos << " a partir de " << pos << endl;
-            copy_train_data(_train_data, new_train_data, pos, (*it)-pos);
-            total += (*it)-pos;
-        }
-        pos = (*it)+1;
-    }
-    if (pos < taille_train) {
-        copy_train_data(_train_data, new_train_data, pos, taille_train-pos);
-        total += taille_train-pos;
+    // les deux vues gardent l'ordre du train
+    vector<unsigned int> dev_indices, train_indices;
+    dev_indices.reserve(taille_dev);
+    train_indices.reserve(taille_train - taille_dev);
+    for (int i=0; i<taille_train; i++) {
+        if (in_dev[i]) dev_indices.push_back(i);
+        else train_indices.push_back(i);
     }
 
-    //cerr << total << " elements copies !" << endl;
-
-    if (new_train_data->num_data != taille_train-taille_dev) {
+    if ((int)dev_indices.size() != taille_dev) {
         ostringstream oss;
-        oss << "Le nouveau train fait " << new_train_data->num_data << " alors qu'il doit faire " << taille_train-taille_dev << ".";
+        oss << "Le dev fait " << dev_indices.size() << " exemples alors qu'il doit en faire " << taille_dev << ".";
         throw *new SfannException(oss.str());
     }
 
-    fann_destroy_train(_train_data);
-    _train_data = new_train_data;
+    SfannMemory::allocate(SFANN_MEM_DATASETS, view_size(taille_train));
+    _dev_data = create_view(_train_data, dev_indices);
+    _train_data = create_view(_train_data, train_indices);
+}
+
+// classe (sortie maximale) de chaque exemple : by_class[c] contient les indices des exemples de la classe c, dans l'ordre
+void Sfann::class_index(const struct fann_train_data * data, vector< vector<unsigned int> > & by_class) {
+    by_class.assign(data->num_output, vector<unsigned int>());
+    for (unsigned int i=0; i<data->num_data; i++) {
+        by_class[max_struct(data->output[i], data->num_output)].push_back(i);
+    }
+}
+
+struct fann_train_data * Sfann::create_view(const struct fann_train_data * src, const vector<unsigned int> & indices) {
+    struct fann_train_data * view = new struct fann_train_data;
+    view->errno_f = FANN_E_NO_ERROR;
+    view->error_log = NULL;
+    view->errstr = NULL;
+    view->num_input = src->num_input;
+    view->num_output = src->num_output;
+    view->num_data = indices.size();
+    view->input = new fann_type * [indices.size()];
+    view->output = new fann_type * [indices.size()];
+    for (size_t i=0; i<indices.size(); i++) {
+        view->input[i] = src->input[indices[i]];
+        view->output[i] = src->output[indices[i]];
+    }
+    return view;
+}
+
+struct fann_train_data * Sfann::create_shuffled_view(const struct fann_train_data * src, SfannRandom & rng, unsigned int block) {
+    unsigned int num_data = src->num_data;
+    vector<unsigned int> indices(num_data);
+    for (unsigned int i=0; i<num_data; i++) indices[i] = i;
+
+    if (block == 0 || block >= num_data) {
+        rng.shuffle(indices);
+    } else {
+        // ordre des blocs aleatoire, puis melange a l'interieur de chaque bloc : les exemples d'un bloc restent proches en memoire
+        unsigned int num_blocks = (num_data + block - 1) / block;
+        vector<unsigned int> blocks(num_blocks);
+        for (unsigned int b=0; b<num_blocks; b++) blocks[b] = b;
+        rng.shuffle(blocks);
+
+        unsigned int pos = 0;
+        for (unsigned int b=0; b<num_blocks; b++) {
+            unsigned int start = blocks[b] * block;
+            unsigned int end = start + block < num_data ? start + block : num_data;
+            for (unsigned int i=start; i<end; i++) indices[pos + i - start] = i;
+            rng.shuffle_range(indices, pos, pos + end - start);
+            pos += end - start;
+        }
+    }
+
+    return create_view(src, indices);
+}
+
+unsigned int Sfann::default_shuffle_block(const struct fann_train_data * data) {
+    // blocs d'environ 256 Ko d'exemples, la taille typique d'un cache L2
+    unsigned long long row = (data->num_input + data->num_output) * sizeof(fann_type);
+    unsigned int block = (unsigned int)((256 * 1024) / (row > 0 ? row : 1));
+    return block > 0 ? block : 1;
+}
+
+void Sfann::delete_view(struct fann_train_data * & view) {
+    if (view == NULL) return;
+    delete[] view->input;
+    delete[] view->output;
+    delete view;
+    view = NULL;
 }
 
 int Sfann::max_struct(fann_type* output, int number) {
@@ -441,10 +1103,100 @@ int Sfann::max_struct(map<int, int> & output) {
 
 
 int FANN_API Sfann::training_callback(struct fann *ann, struct fann_train_data *train,unsigned int max_epochs, unsigned int epochs_between_reports,float desired_error, unsigned int epochs) {
-    Sfann * me = Sfann::me;
-    bool verbose = (*me->config).count("verbose");
+    training_context * ctx = (training_context *) fann_get_user_data(ann);
+    Sfann * me = ctx->sfann;
+
+    // --async-eval : le rapport precedent est fini avant le suivant, son verdict (--cancel-patience) arrive donc un rapport plus tard
+    if (ctx->eval_pending && me->finish_eval(ctx) == -1) {
+        return -1;
+    }
+
+    // le dev et le test ont pu etre lus pendant les premieres epoques
+    if (ctx->late_data) {
+        me->take_late_data(ctx);
+    }
+    if (!ctx->inputs_encoded) {
+        ctx->sparse_dev = me->encode_inputs(ctx->dev, ann, *ctx->config);
+        ctx->sparse_test = me->encode_inputs(ctx->test, ann, *ctx->config);
+        ctx->dev_sample = me->create_dev_sample(ctx);
+        // seules les entrees texte l'imposent : un echantillon dense passe par SfannBatch
+        if (SfannSparse::text_columns(ctx->dev_sample) > 0) ctx->sparse_sample = me->encode_inputs(ctx->dev_sample, ann, *ctx->config);
+        ctx->inputs_encoded = true;
+    }
+
+    report_eval & e = ctx->eval;
+    e.epochs = epochs;
+    e.max_epochs = max_epochs;
+    e.desired_error = desired_error;
+    e.train_mse = fann_get_MSE(ann);
+    e.bit_fail = fann_get_bit_fail(ann);
+    // apprentissage depuis le dernier rapport
+    e.train_time = ctx->progress.train_time;
+    e.train_items = ctx->progress.train_items;
+    ctx->progress.train_time = 0;
+    ctx->progress.train_items = 0;
+
+    if (!(*ctx->config).count("async-eval")) {
+        e.net = ann;
+        return evaluate_report(ctx);
+    }
+
+    // une copie du reseau est evaluee pendant que l'apprentissage continue
+    SfannMemory::allocate(SFANN_MEM_SNAPSHOTS, copy_size(ann));
+    e.net = snapshot_copy(ann, copy_size(ann));
+    e.result = 1;
+    e.error.clear();
+    e.threaded = pthread_create(&e.thread, NULL, eval_worker, ctx) == 0;
+    if (!e.threaded) {
+        // pas de thread disponible : evaluation immediate
+        eval_worker(ctx);
+    }
+    ctx->eval_pending = true;
+    return 1;
+}
+
+void * Sfann::eval_worker(void * arg) {
+    training_context * ctx = (training_context *) arg;
+    try {
+        ctx->eval.result = evaluate_report(ctx);
+    } catch (SfannException & ex) {
+        ctx->eval.error = ex.what();
+        ctx->eval.result = -1;
+    } catch (bad_alloc & ex) {
+        // rendues par finish_eval : aucune exception ne doit sortir du thread
+        ctx->eval.error = "Impossible allocation while evaluating the ANN !";
+        ctx->eval.result = -1;
+    } catch (exception & ex) {
+        ctx->eval.error = string("Error while evaluating the ANN : ") + ex.what();
+        ctx->eval.result = -1;
+    }
+    return NULL;
+}
+
+int Sfann::finish_eval(training_context * ctx) throw (SfannException) {
+    report_eval & e = ctx->eval;
+    if (e.threaded) pthread_join(e.thread, NULL);
+    ctx->eval_pending = false;
+    SfannMemory::release(SFANN_MEM_SNAPSHOTS, net_size(e.net));
+    fann_destroy(e.net);
+    e.net = NULL;
+    if (!e.error.empty()) {
+        throw SfannException(e.error);
+    }
+    return e.result;
+}
 
-    if (epochs == 1 && verbose) {
+int Sfann::evaluate_report(training_context * ctx) {
+    Sfann * me = ctx->sfann;
+    report_eval & e = ctx->eval;
+    struct fann * ann = e.net;
+    unsigned int epochs = e.epochs;
+    unsigned int max_epochs = e.max_epochs;
+    // tableau lisible et/ou journal (--log-format)
+    bool table = ctx->table;
+    bool logging = SfannLog::is_open();
+
+    if (epochs == 1 && table) {
         ostringstream h;
         ostringstream l;
         char head[1024];
@@ -453,150 +1205,227 @@ int FANN_API Sfann::training_callback(struct fann *ann, struct fann_train_data *
         sprintf(line, "+----------+------------+----------");
         h << head;
         l << line;
-        if (me->dev_data != NULL) {
+        if (ctx->dev != NULL) {
             sprintf(head, " : %-8s : %-8s", "Dev MSE", "Dev CCR");
             sprintf(line, "+----------+----------");
             h << head;
             l << line;
         }
-        if (me->test_data != NULL) {
+        if (ctx->test != NULL) {
             sprintf(head, " : %-9s : %-9s", "Test MSE", "Test CCR");
             sprintf(line, "+-----------+-----------");
             h << head;
             l << line;
         }
+        sprintf(head, " : %-10s : %-10s : %-9s", "Train ex/s", "Eval ex/s", "ETA run");
+        sprintf(line, "+------------+------------+-----------");
+        h << head;
+        l << line;
+        if (ctx->progress.num_folds > 0) {
+            sprintf(head, " : %-9s", "ETA CV");
+            sprintf(line, "+-----------");
+            h << head;
+            l << line;
+        }
         cout << "\n";
         cout << h.str() << endl;
         cout << l.str() << endl;
     }
 
-    float train_MSE = fann_get_MSE(ann);
-
-    if (verbose) {
-        unsigned int newBitFail = fann_get_bit_fail(ann);
+    float train_MSE = e.train_mse;
+    unsigned int newBitFail = e.bit_fail;
 
+    if (table) {
         printf(": %08d : %.6f   : %8d", epochs, train_MSE , newBitFail);
     }
 
+    double eval_start = SfannPerf::now();
+    unsigned long long eval_items = 0;
+
+    // --dev-sample : le dev entier (et le test) seulement si l'echantillon progresse, tous les --dev-full-every rapports et au dernier
+    bool full_eval = true;
+    float dev_sample_perfs = -1;
+    if (ctx->dev_sample != NULL) {
+        SfannPerfScope perf("eval.dev_sample");
+        dev_sample_perfs = (float)me->perfs_on_data(ann, ctx->dev_sample, ctx->sparse_sample) / SfannWeights::total(ctx->dev_sample);
+        perf.add_items(ctx->dev_sample->num_data);
+        eval_items += ctx->dev_sample->num_data;
+
+        bool last = epochs == max_epochs || train_MSE <= e.desired_error;
+        full_eval = dev_sample_perfs > ctx->best_sample || ctx->num_reports % (*ctx->config)["dev-full-every"].as<int>() == 0 || last;
+        if (dev_sample_perfs > ctx->best_sample) ctx->best_sample = dev_sample_perfs;
+    }
+    ctx->num_reports++;
+
     int dev_num_ok = -1;
     float dev_perfs = -1;
+    float dev_mse = -1;
     fann_type ** dev_out = NULL;
-    if (me->dev_data != NULL && me->dev_data->num_data > 0) {
-        me->perfs_on_data(ann, me->dev_data, dev_num_ok, dev_out);
-        dev_perfs = (float)dev_num_ok/me->dev_data->num_data;
-
-        if (verbose) {
-            float dev_mse = fann_test_data(ann, me->dev_data);
-            printf(" : %.6f : %6.2f %%", dev_mse, dev_perfs*100);
-        }
+    if (!full_eval) {
+        if (table) printf(" : %8s : %6.2f ~", "-", dev_sample_perfs*100);
+    } else if (ctx->dev != NULL && ctx->dev->num_data > 0) {
+        SfannPerfScope perf("eval.dev");
+        // l'erreur quadratique n'est calculee que pour etre affichee ou journalisee, dans la meme passe
+        me->perfs_on_data(ann, ctx->dev, dev_num_ok, dev_out, ctx->sparse_dev, table || logging ? &dev_mse : NULL);
+        dev_perfs = (float)dev_num_ok/SfannWeights::total(ctx->dev);
+        perf.add_items(ctx->dev->num_data);
+        eval_items += ctx->dev->num_data;
+        if (table) printf(" : %.6f : %6.2f %%", dev_mse, dev_perfs*100);
     }
 
     int test_num_ok = -1;
     float test_perfs = -1;
+    float test_mse = -1;
     fann_type ** test_out = NULL;
-    if (me->test_data != NULL && me->test_data->num_data > 0) {
-        me->perfs_on_data(ann, me->test_data, test_num_ok, test_out);
-        test_perfs = (float)test_num_ok/me->test_data->num_data;
-
-        if (verbose) {
-            float test_mse = fann_test_data(ann, me->test_data);
-            printf(" : %9.6f : %7.2f %%", test_mse, test_perfs*100);
-        }
-    }
-
-    if (verbose) printf("\n");
-
-    if (test_num_ok >= 0 && (me->train_courant->net_max_test == NULL || me->train_courant->net_max_test->test_perfs < test_perfs)) {
+    if (!full_eval) {
+        if (table && ctx->test != NULL) printf(" : %9s : %9s", "-", "-");
+    } else if (ctx->test != NULL && ctx->test->num_data > 0) {
+        SfannPerfScope perf("eval.test");
+        me->perfs_on_data(ann, ctx->test, test_num_ok, test_out, ctx->sparse_test, table || logging ? &test_mse : NULL);
+        test_perfs = (float)test_num_ok/SfannWeights::total(ctx->test);
+        perf.add_items(ctx->test->num_data);
+        eval_items += ctx->test->num_data;
+        if (table) printf(" : %9.6f : %7.2f %%", test_mse, test_perfs*100);
+    }
+
+    double now = SfannPerf::now();
+    double eval_time = now - eval_start;
+    training_progress & p = ctx->progress;
+    // debits depuis le dernier rapport
+    double train_rate = e.train_time > 0 ? e.train_items / e.train_time : 0.;
+    double eval_rate = eval_time > 0 ? eval_items / eval_time : 0.;
+
+    if (table) {
+        printf(" : %10.0f : %10.0f", train_rate, eval_rate);
+
+        // temps restant jusqu'a max_epochs, en supposant les epoques suivantes aussi longues que les precedentes (evaluations comprises)
+        double run_time = now - p.run_start;
+        printf(" : %9s", format_duration(run_time / epochs * (max_epochs - epochs)).c_str());
+
+        if (p.num_folds > 0) {
+            // en epoques : tous les runs de tous les folds
+            double total = (double)p.num_folds * p.num_runs * max_epochs;
+            double done = ((double)p.fold * p.num_runs + p.run) * max_epochs + epochs;
+            printf(" : %9s", format_duration((now - p.cv_start) / done * (total - done)).c_str());
+        }
+
+        printf("\n");
+    }
+
+    if (logging) {
+        log_report r;
+        r.fold = p.num_folds > 0 ? p.fold : -1;
+        r.run = p.run;
+        r.epoch = epochs;
+        r.train_mse = train_MSE;
+        r.bit_fail = newBitFail;
+        r.dev_mse = dev_mse;
+        r.dev_ccr = dev_perfs;
+        r.dev_sample_ccr = dev_sample_perfs;
+        r.test_mse = test_mse;
+        r.test_ccr = test_perfs;
+        r.train_rate = train_rate;
+        r.eval_rate = eval_rate;
+        SfannLog::report(r);
+    }
+
+    if (test_num_ok >= 0 && (ctx->res->net_max_test == NULL || ctx->res->net_max_test->test_perfs < test_perfs)) {
 	// fprintf(stderr, "chk1\n");
-        if (me->train_courant->net_max_test != NULL) delete_net_carac(me->train_courant->net_max_test, 1);
+        if (ctx->res->net_max_test != NULL) delete_net_carac(ctx->res->net_max_test, 1);
 	// fprintf(stderr, "chk1\n");
 
-        me->train_courant->net_max_test = create_empty_net_carac();
-        // fprintf(stderr, "chk1\n");
-        me->train_courant->net_max_test->net = me->fann_copy(ann);
+        // place de la sauvegarde reservee avant les copies (--memory-limit)
+        unsigned long long reserved = snapshot_size(ctx, ann, dev_num_ok >= 0, test_num_ok >= 0);
+        SfannMemory::allocate(SFANN_MEM_SNAPSHOTS, reserved);
+        ctx->res->net_max_test = create_empty_net_carac();
+        ctx->res->net_max_test->net = snapshot_copy(ann, reserved);
         // fprintf(stderr, "chk1\n");
 
-        if (me->train_data != NULL) {
-            me->train_courant->net_max_test->train_mse = train_MSE;
-            me->train_courant->net_max_test->train_num_data = me->train_data->num_data;
+        if (ctx->train != NULL) {
+            ctx->res->net_max_test->train_mse = train_MSE;
+            ctx->res->net_max_test->train_num_data = ctx->train->num_data;
         }
 
-        if (me->dev_data != NULL) {
-            me->train_courant->net_max_test->dev_perfs = dev_perfs;
-            me->train_courant->net_max_test->dev_num_ok = dev_num_ok;
-            me->train_courant->net_max_test->dev_out = copy_matrix<fann_type>(dev_out, me->dev_data->num_data, me->dev_data->num_output);
-            me->train_courant->net_max_test->dev_num_output = me->dev_data->num_output;
-            me->train_courant->net_max_test->dev_num_data = me->dev_data->num_data;
+        if (dev_num_ok >= 0) {
+            ctx->res->net_max_test->dev_perfs = dev_perfs;
+            ctx->res->net_max_test->dev_num_ok = dev_num_ok;
+            ctx->res->net_max_test->dev_out = copy_matrix<fann_type>(dev_out, ctx->dev->num_data, ctx->dev->num_output);
+            ctx->res->net_max_test->dev_num_output = ctx->dev->num_output;
+            ctx->res->net_max_test->dev_num_data = ctx->dev->num_data;
         }
 
-        if (me->test_data != NULL) {
-            me->train_courant->net_max_test->test_perfs = test_perfs;
-            me->train_courant->net_max_test->test_num_ok = test_num_ok;
-            me->train_courant->net_max_test->test_out = copy_matrix<fann_type>(test_out, me->test_data->num_data, me->test_data->num_output);
-            me->train_courant->net_max_test->test_num_output = me->test_data->num_output;
-            me->train_courant->net_max_test->test_num_data = me->test_data->num_data;
+        if (test_num_ok >= 0) {
+            ctx->res->net_max_test->test_perfs = test_perfs;
+            ctx->res->net_max_test->test_num_ok = test_num_ok;
+            ctx->res->net_max_test->test_out = copy_matrix<fann_type>(test_out, ctx->test->num_data, ctx->test->num_output);
+            ctx->res->net_max_test->test_num_output = ctx->test->num_output;
+            ctx->res->net_max_test->test_num_data = ctx->test->num_data;
         }
         // fprintf(stderr, "chk1\n");
     }
 
 
-    if (dev_num_ok >= 0 && (me->train_courant->net_max_dev == NULL || me->train_courant->net_max_dev->dev_perfs < dev_perfs)) {
+    if (dev_num_ok >= 0 && (ctx->res->net_max_dev == NULL || ctx->res->net_max_dev->dev_perfs < dev_perfs)) {
         // fprintf(stderr, "chk2\n");
-        if (me->train_courant->net_max_dev != NULL) delete_net_carac(me->train_courant->net_max_dev, 1);
+        if (ctx->res->net_max_dev != NULL) delete_net_carac(ctx->res->net_max_dev, 1);
         // fprintf(stderr, "chk2\n");
 
-        me->train_courant->net_max_dev = create_empty_net_carac();
-        me->train_courant->net_max_dev->net = me->fann_copy(ann);
+        unsigned long long reserved = snapshot_size(ctx, ann, dev_num_ok >= 0, test_num_ok >= 0);
+        SfannMemory::allocate(SFANN_MEM_SNAPSHOTS, reserved);
+        ctx->res->net_max_dev = create_empty_net_carac();
+        ctx->res->net_max_dev->net = snapshot_copy(ann, reserved);
 
-        if (me->train_data != NULL) {
-            me->train_courant->net_max_dev->train_mse = train_MSE;
-            me->train_courant->net_max_dev->train_num_data = me->train_data->num_data;
+        if (ctx->train != NULL) {
+            ctx->res->net_max_dev->train_mse = train_MSE;
+            ctx->res->net_max_dev->train_num_data = ctx->train->num_data;
         }
 
-        if (me->dev_data != NULL) {
-            me->train_courant->net_max_dev->dev_perfs = dev_perfs;
-            me->train_courant->net_max_dev->dev_num_ok = dev_num_ok;
-            me->train_courant->net_max_dev->dev_out = copy_matrix<fann_type>(dev_out, me->dev_data->num_data, me->dev_data->num_output);
-            me->train_courant->net_max_dev->dev_num_output = me->dev_data->num_output;
-            me->train_courant->net_max_dev->dev_num_data = me->dev_data->num_data;
+        if (dev_num_ok >= 0) {
+            ctx->res->net_max_dev->dev_perfs = dev_perfs;
+            ctx->res->net_max_dev->dev_num_ok = dev_num_ok;
+            ctx->res->net_max_dev->dev_out = copy_matrix<fann_type>(dev_out, ctx->dev->num_data, ctx->dev->num_output);
+            ctx->res->net_max_dev->dev_num_output = ctx->dev->num_output;
+            ctx->res->net_max_dev->dev_num_data = ctx->dev->num_data;
         }
 
-        if (me->test_data != NULL) {
-            me->train_courant->net_max_dev->test_perfs = test_perfs;
-            me->train_courant->net_max_dev->test_num_ok = test_num_ok;
-            me->train_courant->net_max_dev->test_out = copy_matrix<fann_type>(test_out, me->test_data->num_data, me->test_data->num_output);
-            me->train_courant->net_max_dev->test_num_output = me->test_data->num_output;
-            me->train_courant->net_max_dev->test_num_data = me->test_data->num_data;
+        if (test_num_ok >= 0) {
+            ctx->res->net_max_dev->test_perfs = test_perfs;
+            ctx->res->net_max_dev->test_num_ok = test_num_ok;
+            ctx->res->net_max_dev->test_out = copy_matrix<fann_type>(test_out, ctx->test->num_data, ctx->test->num_output);
+            ctx->res->net_max_dev->test_num_output = ctx->test->num_output;
+            ctx->res->net_max_dev->test_num_data = ctx->test->num_data;
         }
     }
 
-    if (me->train_courant->net_max_train == NULL || me->train_courant->net_max_train->train_mse < 0 || me->train_courant->net_max_train->train_mse > train_MSE) {
+    if (ctx->res->net_max_train == NULL || ctx->res->net_max_train->train_mse < 0 || ctx->res->net_max_train->train_mse > train_MSE) {
         // fprintf(stderr, "chk3\n");
-        if (me->train_courant->net_max_train != NULL) delete_net_carac(me->train_courant->net_max_train, 1);
+        if (ctx->res->net_max_train != NULL) delete_net_carac(ctx->res->net_max_train, 1);
         // fprintf(stderr, "chk3\n");
 
-        me->train_courant->net_max_train = create_empty_net_carac();
-        me->train_courant->net_max_train->net = me->fann_copy(ann);
+        unsigned long long reserved = snapshot_size(ctx, ann, dev_num_ok >= 0, test_num_ok >= 0);
+        SfannMemory::allocate(SFANN_MEM_SNAPSHOTS, reserved);
+        ctx->res->net_max_train = create_empty_net_carac();
+        ctx->res->net_max_train->net = snapshot_copy(ann, reserved);
 
-        if (me->train_data != NULL) {
-            me->train_courant->net_max_train->train_mse = train_MSE;
-            me->train_courant->net_max_train->train_num_data = me->train_data->num_data;
+        if (ctx->train != NULL) {
+            ctx->res->net_max_train->train_mse = train_MSE;
+            ctx->res->net_max_train->train_num_data = ctx->train->num_data;
         }
 
-        if (me->dev_data != NULL) {
-            me->train_courant->net_max_train->dev_perfs = dev_perfs;
-            me->train_courant->net_max_train->dev_num_ok = dev_num_ok;
-            me->train_courant->net_max_train->dev_out = copy_matrix<fann_type>(dev_out, me->dev_data->num_data, me->dev_data->num_output);
-            me->train_courant->net_max_train->dev_num_output = me->dev_data->num_output;
-            me->train_courant->net_max_train->dev_num_data = me->dev_data->num_data;
+        if (dev_num_ok >= 0) {
+            ctx->res->net_max_train->dev_perfs = dev_perfs;
+            ctx->res->net_max_train->dev_num_ok = dev_num_ok;
+            ctx->res->net_max_train->dev_out = copy_matrix<fann_type>(dev_out, ctx->dev->num_data, ctx->dev->num_output);
+            ctx->res->net_max_train->dev_num_output = ctx->dev->num_output;
+            ctx->res->net_max_train->dev_num_data = ctx->dev->num_data;
         }
 
-        if (me->test_data != NULL) {
-            me->train_courant->net_max_train->test_perfs = test_perfs;
-            me->train_courant->net_max_train->test_num_ok = test_num_ok;
-            me->train_courant->net_max_train->test_out = copy_matrix<fann_type>(test_out, me->test_data->num_data, me->test_data->num_output);
-            me->train_courant->net_max_train->test_num_output = me->test_data->num_output;
-            me->train_courant->net_max_train->test_num_data = me->test_data->num_data;
+        if (test_num_ok >= 0) {
+            ctx->res->net_max_train->test_perfs = test_perfs;
+            ctx->res->net_max_train->test_num_ok = test_num_ok;
+            ctx->res->net_max_train->test_out = copy_matrix<fann_type>(test_out, ctx->test->num_data, ctx->test->num_output);
+            ctx->res->net_max_train->test_num_output = ctx->test->num_output;
+            ctx->res->net_max_train->test_num_data = ctx->test->num_data;
         }
     }
 
@@ -611,6 +1440,46 @@ int FANN_API Sfann::training_callback(struct fann *ann, struct fann_train_data *
     }
 */
 
+    // les sorties ont ete copiees dans les sauvegardes
+    if (dev_out != NULL) {
+        SfannMemory::release(SFANN_MEM_EVAL, matrix_size(ctx->dev->num_data, ctx->dev->num_output));
+        delete_matrix<fann_type>(dev_out, ctx->dev->num_data, ctx->dev->num_output);
+    }
+    if (test_out != NULL) {
+        SfannMemory::release(SFANN_MEM_EVAL, matrix_size(ctx->test->num_data, ctx->test->num_output));
+        delete_matrix<fann_type>(test_out, ctx->test->num_data, ctx->test->num_output);
+    }
+
+    // --cancel-patience : le run s'arrete quand le dev (ou son echantillon, evalue a chaque rapport) ne progresse plus
+    int patience = (*ctx->config)["cancel-patience"].as<int>();
+    // --cancel-behind : ou quand il reste derriere le run de reference de son fold
+    int behind = (*ctx->config)["cancel-behind"].as<int>();
+    float watched = ctx->dev_sample != NULL ? dev_sample_perfs : dev_perfs;
+    if (watched >= 0) {
+        if (watched > ctx->best_dev) {
+            ctx->best_dev = watched;
+            ctx->stale_reports = 0;
+        } else {
+            ctx->stale_reports++;
+        }
+
+        if (behind > 0 && ctx->reference == NULL) {
+            ctx->trace_epochs.push_back(epochs);
+            ctx->trace_best.push_back(ctx->best_dev);
+        } else if (behind > 0) {
+            // la reference est terminee : sa trace est complete, la decision ne depend pas de l'ordre des taches
+            // (apres son dernier rapport, son meilleur taux final)
+            const training_context * ref = ctx->reference;
+            size_t n = upper_bound(ref->trace_epochs.begin(), ref->trace_epochs.end(), epochs) - ref->trace_epochs.begin();
+            if (n > 0 && ctx->best_dev < ref->trace_best[n - 1]) {
+                if (++ctx->behind_reports >= behind) return -1;
+            } else {
+                ctx->behind_reports = 0;
+            }
+        }
+
+        if (patience > 0 && ctx->stale_reports >= patience) return -1;
+    }
 
     return 1;
 }
@@ -619,6 +1488,9 @@ struct fann* Sfann::fann_copy(const struct fann* orig) {
 /* deep copy of the fann structure */
 /* adapted from FANN CVS */
 
+    SfannPerfScope perf("network.snapshot");
+    perf.add_bytes_allocated(net_size(orig));
+
     struct fann* copy;
     unsigned int num_layers = orig->last_layer - orig->first_layer;
     struct fann_layer *orig_layer_it, *copy_layer_it;
@@ -852,41 +1724,141 @@ struct fann* Sfann::fann_copy(const struct fann* orig) {
 }
 
 
-void Sfann::perfs_on_data(struct fann * net, struct fann_train_data * data, int & nb_bons, fann_type ** & res) {
+void Sfann::perfs_on_data(struct fann * net, struct fann_train_data * data, int & nb_bons, fann_type ** & res, const sparse_inputs * sparse, float * mse) {
     nb_bons = 0;
     int num_data = data->num_data;
     int num_output = data->num_output;
 
     if (res == NULL) {
+        SfannMemory::allocate(SFANN_MEM_EVAL, matrix_size(num_data, num_output));
         res = new fann_type*[num_data];
         for (int i=0; i<num_data; i++) {
             res[i] = new fann_type[num_output];
         }
     }
-    
-    for (int i=0; i<num_data; i++) {
-        res[i] = fann_run(net, data->input[i]);
-        if( max_struct(data->output[i], data->num_output) == max_struct(res[i], data->num_output) ) {
-            nb_bons++;
+
+    // partie constante de la premiere couche, une fois pour tout le corpus
+    vector<fann_type> base;
+    if (sparse != NULL) SfannSparse::baseline(net, sparse, base);
+    // entrees denses : les exemples passent par blocs dans chaque couche
+    bool batch = sparse == NULL && SfannBatch::supports(net);
+    vector<fann_type> buffer;
+    float mse_sum = 0;
+    // --collapse-duplicates : chaque exemple compte autant que son poids
+    bool weighted = SfannWeights::weighted(data);
+
+    for (int first=0; first<num_data; first+=SFANN_BATCH_SIZE) {
+        int count = min(SFANN_BATCH_SIZE, num_data - first);
+        if (batch) SfannBatch::run(net, data->input + first, count, res + first, buffer);
+
+        // classe et erreur de chaque exemple pendant que le bloc est en cache
+        for (int i=first; i<first+count; i++) {
+            if (!batch) {
+                // fann_run renvoie toujours le meme tampon, il faut le copier
+                fann_type * out = sparse != NULL ? SfannSparse::run(net, sparse, base, i) : fann_run(net, data->input[i]);
+                for (int k=0; k<num_output; k++) res[i][k] = out[k];
+            }
+            unsigned int w = weighted ? SfannWeights::weight(data, i) : 1;
+            if( max_struct(data->output[i], data->num_output) == max_struct(res[i], data->num_output) ) {
+                nb_bons += w;
+            }
+            if (mse != NULL && w == 1) {
+                SfannBatch::add_squared_error(net, data->output[i], res[i], mse_sum);
+            } else if (mse != NULL) {
+                float error = 0;
+                SfannBatch::add_squared_error(net, data->output[i], res[i], error);
+                mse_sum += error * w;
+            }
         }
     }
+    if (mse != NULL) *mse = num_data > 0 ? mse_sum / SfannWeights::total(data) : 0;
 }
 
-int Sfann::perfs_on_data(struct fann * net, struct fann_train_data * data) {
+int Sfann::perfs_on_data(struct fann * net, struct fann_train_data * data, const sparse_inputs * sparse) {
     int nb_bons = 0;
     int nb_dev_data = data->num_data;
+    bool weighted = SfannWeights::weighted(data);
+
+    if (sparse != NULL || !SfannBatch::supports(net)) {
+        fann_type * out;
+        vector<fann_type> base;
+        if (sparse != NULL) SfannSparse::baseline(net, sparse, base);
+        for (int i=0; i<nb_dev_data; i++) {
+            out = sparse != NULL ? SfannSparse::run(net, sparse, base, i) : fann_run(net, data->input[i]);
+            if( max_struct(data->output[i], data->num_output) == max_struct(out, data->num_output) ) {
+                nb_bons += weighted ? SfannWeights::weight(data, i) : 1;
+            }
+        }
+        return nb_bons;
+    }
 
-    fann_type * out;
-    for (int i=0; i<nb_dev_data; i++) {
-        out = fann_run(net, data->input[i]);
-        if( max_struct(data->output[i], data->num_output) == max_struct(out, data->num_output) ) {
-            nb_bons++;
+    // sorties d'un seul bloc a la fois
+    vector<fann_type> values(SFANN_BATCH_SIZE * data->num_output);
+    fann_type * out[SFANN_BATCH_SIZE];
+    for (int b=0; b<SFANN_BATCH_SIZE; b++) out[b] = &values[b * data->num_output];
+    vector<fann_type> buffer;
+    for (int first=0; first<nb_dev_data; first+=SFANN_BATCH_SIZE) {
+        int count = min(SFANN_BATCH_SIZE, nb_dev_data - first);
+        SfannBatch::run(net, data->input + first, count, out, buffer);
+        for (int b=0; b<count; b++) {
+            if( max_struct(data->output[first + b], data->num_output) == max_struct(out[b], data->num_output) ) {
+                nb_bons += weighted ? SfannWeights::weight(data, first + b) : 1;
+            }
         }
     }
 
     return nb_bons;
 }
 
+struct fann_train_data * Sfann::create_dev_sample(training_context * ctx) {
+    const struct fann_train_data * dev = ctx->dev;
+    int sample_size = (*ctx->config)["dev-sample"].as<int>();
+    if (dev == NULL || sample_size <= 0 || (unsigned int)sample_size >= dev->num_data) return NULL;
+
+    // meme echantillon pour tous les runs : les classes gardent leur proportion (au moins un exemple chacune)
+    SfannRandom sample_rng(ctx->seed);
+    vector< vector<unsigned int> > by_class;
+    class_index(dev, by_class);
+    vector<unsigned int> indices;
+    for (size_t c=0; c<by_class.size(); c++) {
+        if (by_class[c].empty()) continue;
+        size_t k = (size_t)((double)by_class[c].size() * sample_size / dev->num_data + 0.5);
+        if (k < 1) k = 1;
+        sample_rng.partial_shuffle(by_class[c], k);
+        indices.insert(indices.end(), by_class[c].begin(), by_class[c].begin() + min(k, by_class[c].size()));
+    }
+    // dans l'ordre du dev, pour le parcourir en sequence
+    sort(indices.begin(), indices.end());
+
+    SfannMemory::allocate(SFANN_MEM_DATASETS, view_size(indices.size()));
+    return create_view(dev, indices);
+}
+
+void Sfann::complete_net_carac(training_context * ctx, net_carac * nc) {
+    if (nc == NULL || nc->net == NULL) return;
+    SfannMemory::release(SFANN_MEM_SNAPSHOTS, net_carac_size(nc));
+    // les sorties calculees par perfs_on_data appartiennent desormais a la sauvegarde
+    if (nc->dev_num_ok < 0 && ctx->dev != NULL && ctx->dev->num_data > 0) {
+        SfannPerfScope perf("eval.dev");
+        perfs_on_data(nc->net, ctx->dev, nc->dev_num_ok, nc->dev_out, ctx->sparse_dev);
+        perf.add_items(ctx->dev->num_data);
+        SfannMemory::release(SFANN_MEM_EVAL, matrix_size(ctx->dev->num_data, ctx->dev->num_output));
+        nc->dev_perfs = (float)nc->dev_num_ok / SfannWeights::total(ctx->dev);
+        nc->dev_num_output = ctx->dev->num_output;
+        nc->dev_num_data = ctx->dev->num_data;
+    }
+    if (nc->test_num_ok < 0 && ctx->test != NULL && ctx->test->num_data > 0) {
+        SfannPerfScope perf("eval.test");
+        perfs_on_data(nc->net, ctx->test, nc->test_num_ok, nc->test_out, ctx->sparse_test);
+        perf.add_items(ctx->test->num_data);
+        SfannMemory::release(SFANN_MEM_EVAL, matrix_size(ctx->test->num_data, ctx->test->num_output));
+        nc->test_perfs = (float)nc->test_num_ok / SfannWeights::total(ctx->test);
+        nc->test_num_output = ctx->test->num_output;
+        nc->test_num_data = ctx->test->num_data;
+    }
+    SfannMemory::allocate(SFANN_MEM_SNAPSHOTS, net_carac_size(nc));
+}
+
 
 training_res * Sfann::create_training_res() {
     training_res * t = new training_res[1];
@@ -1009,6 +1981,29 @@ void Sfann::add_training_res(training_res * src, training_res * dest) {
     add_net_carac(src->net_max_dev, dest->net_max_dev);
 }
 
+// memes comparaisons que training_callback : merger les runs dans l'ordre donne les reseaux d'un apprentissage sequentiel
+void Sfann::merge_training_res(training_res * src, training_res * dest) {
+    if (src == NULL || dest == NULL) return;
+    if (src->net_max_test != NULL && (dest->net_max_test == NULL || dest->net_max_test->test_perfs < src->net_max_test->test_perfs)) {
+        delete_net_carac(dest->net_max_test, 1);
+        dest->net_max_test = src->net_max_test;
+        src->net_max_test = NULL;
+    }
+    if (src->net_max_dev != NULL && (dest->net_max_dev == NULL || dest->net_max_dev->dev_perfs < src->net_max_dev->dev_perfs)) {
+        delete_net_carac(dest->net_max_dev, 1);
+        dest->net_max_dev = src->net_max_dev;
+        src->net_max_dev = NULL;
+    }
+    if (src->net_max_train != NULL && (dest->net_max_train == NULL || dest->net_max_train->train_mse < 0 || dest->net_max_train->train_mse > src->net_max_train->train_mse)) {
+        delete_net_carac(dest->net_max_train, 1);
+        dest->net_max_train = src->net_max_train;
+        src->net_max_train = NULL;
+    }
+    delete_net_carac(src->net_max_test, 1);
+    delete_net_carac(src->net_max_dev, 1);
+    delete_net_carac(src->net_max_train, 1);
+}
+
 
 void Sfann::print_net_carac(net_carac * nc) {
     if (nc != NULL) {
@@ -1040,10 +2035,29 @@ void Sfann::print_training_res(training_res * t) {
         }
 }
 
+void Sfann::log_training_res(training_res * t, int fold, int run) {
+    if (t == NULL || !SfannLog::is_open()) return;
+
+    net_carac * nets[3] = {t->net_max_train, t->net_max_dev, t->net_max_test};
+    const char * names[3] = {"train", "dev", "test"};
+    for (int k=0; k<3; k++) {
+        if (nets[k] == NULL) continue;
+        log_result r;
+        r.fold = fold;
+        r.run = run;
+        r.best_on = names[k];
+        r.train_mse = nets[k]->train_mse;
+        r.dev_ccr = nets[k]->dev_perfs;
+        r.test_ccr = nets[k]->test_perfs;
+        SfannLog::result(r);
+    }
+}
+
 void Sfann::delete_net_carac(net_carac * & nc, int nb_nc) {
     if (nc == NULL) return;
 
     for (int k=0; k<nb_nc; k++) {
+        SfannMemory::release(SFANN_MEM_SNAPSHOTS, net_carac_size(&nc[k]));
         if (nc[k].net != NULL) {
             fann_destroy(nc[k].net);
         }
@@ -1134,6 +2148,8 @@ void Sfann::delete_fann_train_data(struct fann_train_data * & d, int nb) {
             delete[] d[n].input[i];
             delete[] d[n].output[i];
         }
+        delete[] d[n].input;
+        delete[] d[n].output;
         //if (d[n].errstr != NULL) delete[] d[n].errstr;
         //if (d[n].error_log != NULL) delete d[n].error_log;
     }
@@ -1144,34 +2160,15 @@ void Sfann::delete_fann_train_data(struct fann_train_data * & d, int nb) {
 void Sfann::delete_train_dev_test_couple(train_dev_test_couple * & cross_corpora, int nb_copora) {
     if (cross_corpora == NULL) {return;}
     for (int k=0; k<nb_copora; k++) {
-        //struct fann_train_data * p = &(cross_corpora[k].train);
-        delete_fann_train_data(cross_corpora[k].train, 1);
-        delete_fann_train_data(cross_corpora[k].dev, 1);
-        delete_fann_train_data(cross_corpora[k].test, 1);
-//     fann_destroy_train(&(cross_corpora[k].train));
-//        fann_destroy_train(&(cross_corpora[k].dev));
-//       fann_destroy_train(&(cross_corpora[k].test));
+        // ce sont des vues du corpus de train
+        delete_view(cross_corpora[k].train);
+        delete_view(cross_corpora[k].dev);
+        delete_view(cross_corpora[k].test);
     }
     delete[] cross_corpora;
     cross_corpora = NULL;
 }
 
-void Sfann::delete_folds(folds * & f) {
-    if (f == NULL) return;
-
-    for (int k=0; k<f->num_folds; k++) {
-        fann_destroy_train(&f->data[k]);
-        /*for (int j=0; j<f->data[k].num_data; j++) {
-            if (f->data[k].input[j] != NULL) delete[] f->data[k].input[j];
-            if (f->data[k].output[j] != NULL) delete[] f->data[k].output[j];
-            if (f->data[k].errstr != NULL) free(f->data[k].errstr);
-        }*/
-    }
-    delete[] f->data;
-    delete f;
-    f = NULL;
-}
-
 train_dev_test_couple * create_train_dev_test_couple() {
     train_dev_test_couple * t = new train_dev_test_couple;
     t->train = NULL;
@@ -1180,27 +2177,6 @@ train_dev_test_couple * create_train_dev_test_couple() {
     return t;
 }
 
-void Sfann::generate_folds_from_train_corpus(struct fann_train_data * train_data, folds & _folds, int cross_nb_folds) {
-    int num_by_fold = train_data->num_data/cross_nb_folds + 1;
-    cout << train_data->num_data << " into " << cross_nb_folds << " folds = " << num_by_fold << " / fold... ";
-
-    _folds.data = new struct fann_train_data[cross_nb_folds];
-    _folds.num_folds = cross_nb_folds;
-    for (int i=0; i<cross_nb_folds; ++i) {
-        init_structure_metadata(train_data, &(_folds.data[i]), num_by_fold);
-    }
-
-    int nb_copies = 0;
-    while (nb_copies < train_data->num_data) {
-        for (int i=0; i<cross_nb_folds; ++i) {
-            copy_train_data(train_data, &(_folds.data[i]), nb_copies, 1);
-            nb_copies++;
-            if (nb_copies >= train_data->num_data) break;
-        }
-    }
-    _folds.num_data = nb_copies;
-}
-
 // Cree un fann_train_data pour un nombre donne d'exemples (num_data), et utilise src pour copier les meta-donnees
 void Sfann::init_structure_metadata(struct fann_train_data * src, struct fann_train_data * dest, int num_data) {
 // 	cerr << "Init " << num_data << endl;
@@ -1250,285 +2226,835 @@ void Sfann::copy_train_data(struct fann_train_data * src, struct fann_train_data
 
 
 
-void Sfann::generate_cross_corpus(folds & _folds, train_dev_test_couple * cross_corpus, int num_test_fold, int nb_dev_folds) {
+void Sfann::generate_cross_corpus(struct fann_train_data * train_data, folds & _folds, train_dev_test_couple * cross_corpus, int num_test_fold, int nb_dev_folds) {
 
     if (cross_corpus == NULL) return;
 
     set<int> dev_folds;
-    int num_dev_data = 0;
     int pos = num_test_fold + 1;
     for (int i=0; i<nb_dev_folds; i++) {
         if (pos >= _folds.num_folds) pos = 0;
-        num_dev_data += _folds.data[pos].num_data;
         dev_folds.insert(pos);
         pos++;
     }
 
-    printf(" test:%d dev:%d train:%d... ", _folds.data[num_test_fold].num_data, num_dev_data, _folds.num_data - _folds.data[num_test_fold].num_data - num_dev_data);
-
-    cross_corpus->test = new struct fann_train_data;
-    cross_corpus->dev = new struct fann_train_data;
-    cross_corpus->train = new struct fann_train_data;
-
-    init_structure_metadata(&(_folds.data[0]), cross_corpus->test, _folds.data[num_test_fold].num_data);
-    init_structure_metadata(&(_folds.data[0]), cross_corpus->dev, num_dev_data);
-    init_structure_metadata(&(_folds.data[0]), cross_corpus->train, _folds.num_data - _folds.data[num_test_fold].num_data - num_dev_data);
-
+    vector<unsigned int> train_indices, dev_indices;
+    train_indices.reserve(_folds.num_data);
     for (int n=0; n<_folds.num_folds; n++) {
-        if (n == num_test_fold) {
-            // creation du corpus de test
-            copy_train_data(&(_folds.data[n]), cross_corpus->test);
-        } else if (dev_folds.count(n) > 0) {
-            // creation du corpus de dev
-            copy_train_data(&(_folds.data[n]), cross_corpus->dev);
-        } else {
-            // creation du corpus de train
-            copy_train_data(&(_folds.data[n]), cross_corpus->train);
-        }
+        if (n == num_test_fold) continue;
+        vector<unsigned int> & dest = dev_folds.count(n) > 0 ? dev_indices : train_indices;
+        dest.insert(dest.end(), _folds.indices[n].begin(), _folds.indices[n].end());
     }
+
+    SfannMemory::allocate(SFANN_MEM_FOLDS, view_size(_folds.num_data));
+
+    // les exemples ne sont pas copies
+    cross_corpus->test = create_view(train_data, _folds.indices[num_test_fold]);
+    cross_corpus->dev = create_view(train_data, dev_indices);
+    cross_corpus->train = create_view(train_data, train_indices);
 }
 
 void Sfann::do_training() {
+    this->do_training(*this->config);
+}
+
+void Sfann::do_training(const variables_map & config) {
 
     training_res * res_global = NULL;
-    bool verbose = (*me->config).count("verbose");
+    bool verbose = config.count("verbose");
+
+    if (config.count("jobs-file")) {
+        // les processus des experiences partagent les corpus : ils doivent etre complets avant fork
+        this->wait_data();
+        int parallel = config["jobs-parallel"].as<int>();
+        if (parallel == 0) parallel = sysconf(_SC_NPROCESSORS_ONLN);
+        int failed = SfannJobs::run(this->jobs, parallel, config["jobs-dir"].as<string>(), run_job);
+        // code de sortie non nul des qu'une experience a echoue (voir jobs.tsv)
+        if (failed > 0) {
+            ostringstream oss;
+            oss << failed << " of the " << this->jobs.size() << " experiments failed (see " << config["jobs-dir"].as<string>() << "/jobs.tsv)";
+            throw *new SfannException(oss.str());
+        }
+        return;
+    }
+
+    if (config.count("log-format")) {
+        SfannLog::open(config["log-file"].as<string>(), config["log-format"].as<string>());
+    }
+
+    // seul l'apprentissage simple demarre avant la fin de la lecture du dev et du test (attendus au premier rapport)
+    if (!config.count("do-training")) {
+        this->wait_data();
+    }
 
-    if ((*this->config).count("do-nothing")) {
+    if (config.count("do-nothing")) {
         return;
-    } else if ((*this->config).count("do-cross-validation")) {
+    } else if (config.count("do-cross-validation")) {
         int cross_nb_folds = 0;
         int cross_nb_dev = 0;
 
-        bool cross_shuffle_data = (*this->config).count("cv-shuffle");
-        if ((*this->config).count("cv-num-folds")) cross_nb_folds = (*this->config)["cv-num-folds"].as<int>();
-        if ((*this->config).count("cv-num-dev")) cross_nb_dev = (*this->config)["cv-num-dev"].as<int>();
-        if ((*this->config).count("leave-one-out")) cross_nb_folds = this->train_data->num_data;
-
-        if (cross_nb_folds > 0) {
-            cout << " ->  Creating cross-validation folds... ";
-            folds cross_folds;
-            if (cross_shuffle_data) fann_shuffle_train_data(this->train_data);
-            this->generate_folds_from_train_corpus(this->train_data, cross_folds, cross_nb_folds);
-            cout << "Ok !" << endl;
+        int cross_repeats = config["cv-repeats"].as<int>();
+        // des repetitions identiques n'auraient pas de sens
+        bool cross_shuffle_data = config.count("cv-shuffle") || cross_repeats > 1;
+        if (config.count("cv-num-folds")) cross_nb_folds = config["cv-num-folds"].as<int>();
+        if (config.count("cv-num-dev")) cross_nb_dev = config["cv-num-dev"].as<int>();
+        if (config.count("leave-one-out")) cross_nb_folds = this->train_data->num_data;
 
-            //      cout << cross_folds.num_folds << endl;
-
-            // sauvegarde du contexte
-            struct fann_train_data * train_tmp = this->train_data, * dev_tmp = this->dev_data, * test_tmp = this->test_data;
-            this->train_data = NULL; this->dev_data = NULL; this->test_data = NULL;
-            res_global = this->create_training_res();
+        bool fast_loo = config.count("leave-one-out") && config["loo-mode"].as<string>() == "fast";
 
-            for (int i=0; i<cross_nb_folds; ++i) {
-                cout << " ->  Validation number " << i+1 << " ..." << endl;
+        if (fast_loo) {
+            res_global = this->do_fast_leave_one_out(config, config["threads"].as<int>(), config["loo-fine-tune"].as<int>());
 
-                cout << "     - creating corpus couple ... "; fflush(stdout);
-                train_dev_test_couple * cc = create_train_dev_test_couple();
-                this->generate_cross_corpus(cross_folds, cc, i, cross_nb_dev);
+            printf(" => Overall classif. rate :\n");
+            print_training_res(res_global);
+            log_training_res(res_global, -1, -1);
+
+        } else if (cross_nb_folds > 0) {
+            // une seule passe pour ranger les exemples par classe, reutilisee par chaque repetition
+            SfannPerfScope perf_index("folds.index");
+            vector< vector<unsigned int> > by_class;
+            class_index(this->train_data, by_class);
+            perf_index.add_items(this->train_data->num_data);
+            perf_index.stop();
+
+            // --trials-file : les runs de chaque essai, avec ses options (un seul essai sans le fichier)
+            vector<sfann_job> trials;
+            vector<variables_map *> configs;
+            this->read_trials(config, trials, configs);
+            int trial_runs = config["num-runs"].as<int>();
+            int num_runs = trial_runs * configs.size();
+            int num_folds = cross_nb_folds * cross_repeats;
+            int behind = config["cancel-behind"].as<int>();
+            bool table = verbose && !config.count("no-table");
+
+            // les folds de toutes les repetitions, avant les apprentissages
+            vector<folds> cross_folds(cross_repeats);
+            unsigned int seed = this->seed_of(config);
+            for (int r=0; r<cross_repeats; ++r) {
+                // chaque repetition a sa propre graine, pour pouvoir etre rejouee seule
+                SfannRandom cross_rng(seed + r);
+                if (cross_shuffle_data) cout << " ->  Repetition " << r+1 << "/" << cross_repeats << " (seed " << seed + r << ")" << endl;
+
+                cout << " ->  Creating cross-validation folds... ";
+                SfannPerfScope perf_folds("folds.generate");
+                SfannFolds::stratify(by_class, cross_folds[r], cross_nb_folds, cross_shuffle_data ? &cross_rng : NULL);
+                cout << cross_folds[r].num_data << " into " << cross_nb_folds << " stratified folds = " << cross_folds[r].num_data / cross_nb_folds << " / fold... ";
+                perf_folds.add_items(cross_folds[r].num_data);
+                perf_folds.add_bytes_allocated(cross_folds[r].num_data * sizeof(unsigned int));
+                perf_folds.stop();
                 cout << "Ok !" << endl;
+            }
 
-                cout << "     - training ... "; fflush(stdout);
-
-                this->train_data = cc->train;
-                if (cc->dev->num_data > 0) {
-                    this->dev_data = cc->dev;
-                } else {
-                    this->dev_data = NULL;
+            // un run d'un fold par tache : les vues du fold sont creees par la tache et liberees a sa fin
+            int workers = this->num_workers(config, num_folds * num_runs);
+            SfannTasks pool(workers);
+            vector<training_task> tasks(num_folds * num_runs);
+            double cv_start = SfannPerf::now();
+            for (int f=0; f<num_folds; ++f) {
+                for (int k=0; k<num_runs; ++k) {
+                    training_task & t = tasks[f * num_runs + k];
+                    this->init_context(t.ctx, *configs[k / trial_runs], NULL, NULL, NULL, table && workers == 1);
+                    t.ctx.pool = &pool;
+                    t.ctx.progress.cv_start = cv_start;
+                    t.ctx.progress.fold = f;
+                    t.ctx.progress.num_folds = num_folds;
+                    t.ctx.progress.run = k;
+                    t.ctx.progress.num_runs = num_runs;
+                    t.detail = 0;
+                    t.cv_folds = &cross_folds[f / cross_nb_folds];
+                    t.cv_source = this->train_data;
+                    t.test_fold = f % cross_nb_folds;
+                    t.nb_dev_folds = cross_nb_dev;
                 }
-                if (cc->test->num_data > 0) {
-                    this->test_data = cc->test;
-                } else {
-                    this->test_data = NULL;
+            }
+            // le premier run de chaque fold d'abord : avec --cancel-behind, les autres runs du fold attendent sa fin pour s'y comparer
+            for (int f=0; f<num_folds; ++f) {
+                tasks[f * num_runs].ctx.task = pool.add(&tasks[f * num_runs]);
+            }
+            for (int f=0; f<num_folds; ++f) {
+                training_context & first = tasks[f * num_runs].ctx;
+                for (int k=1; k<num_runs; ++k) {
+                    training_task & t = tasks[f * num_runs + k];
+                    if (behind > 0) {
+                        t.ctx.reference = &first;
+                        t.ctx.task = pool.add(&t, first.task);
+                    } else {
+                        t.ctx.task = pool.add(&t);
+                    }
                 }
+            }
 
-                training_res * res = this->do_normal_training(0);
-
+            if (!trials.empty()) cout << " ->  " << trials.size() << " trials of " << trial_runs << " runs" << endl;
+            cout << " ->  Training " << num_folds << " folds x " << num_runs << " runs (" << workers << " threads) ... "; fflush(stdout);
+            string error;
+            try {
+                pool.run();
                 cout << "Ok !" << endl;
+            } catch (SfannException & e) {
+                error = e.what();
+            }
+            for (size_t c=0; c<configs.size(); c++) delete configs[c];
 
-                printf("     - classif. rate for this iteration :\n");
-                print_training_res(res);
-
-                this->add_training_res(res, res_global);
-
-                this->delete_train_dev_test_couple(cc, 1);
-                this->train_data = NULL; this->dev_data = NULL; this->test_data = NULL;
+            // agregation dans l'ordre des folds et des runs, comme un apprentissage sequentiel
+            res_global = this->create_training_res();
+            for (int f=0; f<num_folds; ++f) {
+                training_res * res = this->create_training_res();
+                for (int k=0; k<num_runs; ++k) {
+                    this->merge_training_res(tasks[f * num_runs + k].ctx.res, res);
+                    this->delete_training_res(tasks[f * num_runs + k].ctx.res, 1);
+                    if (error.empty()) log_training_res(res, f, k);
+                }
+                if (error.empty()) {
+                    folds & cf = cross_folds[f / cross_nb_folds];
+                    int num_test = cf.indices[f % cross_nb_folds].size();
+                    int num_dev = 0;
+                    for (int n=1; n<=cross_nb_dev; n++) num_dev += cf.indices[(f % cross_nb_folds + n) % cross_nb_folds].size();
+                    cout << " ->  Validation number " << f % cross_nb_folds + 1 << " (test:" << num_test << " dev:" << num_dev << " train:" << cf.num_data - num_test - num_dev << ")" << endl;
+                    printf("     - classif. rate for this iteration :\n");
+                    print_training_res(res);
+                    this->add_training_res(res, res_global);
+                }
                 this->delete_training_res(res, 1);
             }
-
-            // restauration du contexte
-            this->train_data = train_tmp;
-            this->dev_data = dev_tmp;
-            this->test_data = test_tmp;
+            if (!error.empty()) {
+                this->delete_training_res(res_global, 1);
+                throw SfannException(error);
+            }
 
             printf(" => Overall classif. rate :\n");
             print_training_res(res_global);
+            log_training_res(res_global, -1, -1);
 
 //             this->delete_training_res(res_global, 1);
         }
 
-    } else if ((*this->config).count("do-training")) {
-        res_global = this->do_normal_training(1);
+    } else if (config.count("do-training")) {
+        res_global = this->do_normal_training(config, this->train_data, this->dev_data, this->test_data, 1);
 
         // save the desired ann
-        if ((*this->config).count("save-max-dev") && res_global->net_max_dev->net != NULL) {
-            fann_save(res_global->net_max_dev->net, (*this->config)["save-max-dev"].as<string>().c_str());
+        SfannPerfScope perf_save("model.save");
+        bool binary = (config["model-format"].as<string>() == "binary");
+        if (config.count("save-max-dev") && res_global->net_max_dev->net != NULL) {
+            this->save_model(res_global->net_max_dev->net, config["save-max-dev"].as<string>(), binary);
         }
-        if ((*this->config).count("save-max-test") && res_global->net_max_test->net != NULL) {
-            fann_save(res_global->net_max_test->net, (*this->config)["save-max-test"].as<string>().c_str());
+        if (config.count("save-max-test") && res_global->net_max_test->net != NULL) {
+            this->save_model(res_global->net_max_test->net, config["save-max-test"].as<string>(), binary);
         }
-        if ((*this->config).count("save-max-train") && res_global->net_max_train->net != NULL) {
-            fann_save(res_global->net_max_train->net, (*this->config)["save-max-train"].as<string>().c_str());
+        if (config.count("save-max-train") && res_global->net_max_train->net != NULL) {
+            this->save_model(res_global->net_max_train->net, config["save-max-train"].as<string>(), binary);
         }
+        perf_save.stop();
 
-        if (this->test_data != NULL && ((*this->config).count("save-max-dev-run") || (*this->config).count("save-max-test-run") || (*this->config).count("save-max-train-run"))) {
+        if (this->test_data != NULL && (config.count("save-max-dev-run") || config.count("save-max-test-run") || config.count("save-max-train-run"))) {
             // save the desired results
             fann_train_data * tmp = new fann_train_data;
             init_structure_metadata(this->test_data, tmp, 0);
             tmp->input = this->test_data->input;
             tmp->num_data = this->test_data->num_data;
 
-            if ((*this->config).count("save-max-dev-run") && res_global->net_max_dev->test_out != NULL) {
+            if (config.count("save-max-dev-run") && res_global->net_max_dev->test_out != NULL) {
                 tmp->output = res_global->net_max_dev->test_out;
-                fann_save_train(tmp, (*this->config)["save-max-dev-run"].as<string>().c_str());
+                fann_save_train(tmp, config["save-max-dev-run"].as<string>().c_str());
             }
 
-            if ((*this->config).count("save-max-test-run") && res_global->net_max_test->test_out != NULL) {
+            if (config.count("save-max-test-run") && res_global->net_max_test->test_out != NULL) {
                 tmp->output = res_global->net_max_test->test_out;
-                fann_save_train(tmp, (*this->config)["save-max-test-run"].as<string>().c_str());
+                fann_save_train(tmp, config["save-max-test-run"].as<string>().c_str());
             }
 
-            if ((*this->config).count("save-max-train-run") && res_global->net_max_train->test_out != NULL) {
+            if (config.count("save-max-train-run") && res_global->net_max_train->test_out != NULL) {
                 tmp->output = res_global->net_max_train->test_out;
-                fann_save_train(tmp, (*this->config)["save-max-train-run"].as<string>().c_str());
+                fann_save_train(tmp, config["save-max-train-run"].as<string>().c_str());
             }
             
             delete tmp;
         }
         
-    } else if ((*this->config).count("do-running")) {
-        printf("-> Loading %s ...", (*this->config)["load-ann"].as<string>().c_str());
-        struct fann * net = fann_create_from_file((*this->config)["load-ann"].as<string>().c_str());
+    } else if (config.count("do-running")) {
+        printf("-> Loading %s ...", config["load-ann"].as<string>().c_str());
+        SfannPerfScope perf_load("model.load");
+        struct fann * net = SfannModel::load(config["load-ann"].as<string>(), true);
+        perf_load.add_bytes_read(file_size(config["load-ann"].as<string>()));
+        perf_load.stop();
         printf(" Ok !\n");
+
+        // entrees retirees a l'apprentissage (--prune-inputs)
+        feature_map features;
+        if (SfannFeatures::load(SfannFeatures::file_of(config["load-ann"].as<string>()), features) && SfannSparse::text_columns(this->test_data) == 0 && this->test_data->num_input != net->num_input) {
+            struct fann_train_data * projected = project_data(this->test_data, features);
+            SfannMemory::release(SFANN_MEM_DATASETS, data_size(this->test_data));
+            fann_destroy_train(this->test_data);
+            this->test_data = projected;
+            printf("-> Inputs projected on the %u kept at training\n", projected->num_input);
+        }
+        // les noyaux creux liraient des poids hors du reseau
+        if (SfannSparse::text_columns(this->test_data) > 0 && SfannSparse::num_inputs(this->test_data) != net->num_input) {
+            ostringstream oss;
+            oss << "The test data have " << SfannSparse::num_inputs(this->test_data) << " inputs, the ANN " << net->num_input << " !";
+            fann_destroy(net);
+            throw SfannException(oss.str());
+        }
         
         int nb_ok = 0;
         fann_type ** output = NULL;
-        perfs_on_data(net, this->test_data, nb_ok, output);
+        sparse_inputs * sparse = encode_inputs(this->test_data, net, config);
+        SfannPerfScope perf_run("run.test");
+        perfs_on_data(net, this->test_data, nb_ok, output, sparse);
+        perf_run.add_items(this->test_data->num_data);
+        perf_run.stop();
+        release_inputs(sparse);
 
         printf("-> Classification rate on the test data : %.2f\n", (float)nb_ok*100/(float)this->test_data->num_data);
 
-        if ((*this->config).count("save-loaded-run")) {
+        if (config.count("save-loaded-run")) {
             fann_train_data * tmp = new fann_train_data;
             init_structure_metadata(this->test_data, tmp, 0);
             tmp->input = this->test_data->input;
             tmp->output = output;
             tmp->num_data = this->test_data->num_data;
 
-            fann_save_train(tmp, (*this->config)["save-loaded-run"].as<string>().c_str());
+            fann_save_train(tmp, config["save-loaded-run"].as<string>().c_str());
 
             delete tmp;
         }
 
+        SfannMemory::release(SFANN_MEM_EVAL, matrix_size(this->test_data->num_data, this->test_data->num_output));
+        delete_matrix<fann_type>(output, this->test_data->num_data, this->test_data->num_output);
+        SfannModel::destroy(net);
+
+    } else if (config.count("do-converting")) {
+        string src = config["load-ann"].as<string>();
+        string dest = config["save-ann"].as<string>();
+        string format = config["model-format"].as<string>();
+        printf("-> Converting %s to %s (%s format) ...", src.c_str(), dest.c_str(), format.c_str());
+        SfannModel::convert(src, dest, format == "binary");
+        // la projection des entrees suit le modele
+        feature_map features;
+        if (SfannFeatures::load(SfannFeatures::file_of(src), features)) {
+            SfannFeatures::save(features, SfannFeatures::file_of(dest));
+        } else {
+            remove(SfannFeatures::file_of(dest).c_str());
+        }
+        printf(" Ok !\n");
     }
 
     this->delete_training_res(res_global, 1);
+
+    SfannLog::close();
+
+    cout << "-> Memory : " << SfannMemory::summary() << endl;
 }
 
+void Sfann::write_perf_report() throw (SfannException) {
+    this->write_perf_report(*this->config);
+}
+
+void Sfann::write_perf_report(const variables_map & config) throw (SfannException) {
+    if (config.count("perf-report")) {
+        SfannPerf::write_json(config["perf-report"].as<string>());
+    }
+}
 
-training_res * Sfann::do_normal_training(int detail) {
-    int num_input = fann_num_input_train_data(this->train_data);
-    int num_output = fann_num_output_train_data(this->train_data);
-    int num_hidden = (*this->config)["num-hidden"].as<int>();
-    int num_runs = (*this->config)["num-runs"].as<int>();
-    int max_epochs = (*this->config)["max-epoch"].as<int>();
-    int num_reports = (*this->config)["reports"].as<int>();
-    float desired_error = (*this->config)["desired-error"].as<float>();
-    bool randomize = (*this->config).count("randomize-data");
-    bool clever_init = (*this->config).count("clever-init");
 
-    if (detail > 0) cout << " ->  Network has 3 layers : " << num_input << "->" << num_hidden << "->" << num_output << endl;
-    if (detail > 0) cout << " ->  Training on " << this->train_data->num_data << " data (" << this->train_data->num_input << "->" << this->train_data->num_output << ")" << endl;
-    if (randomize && detail > 0) cout << " ->  Training data are shuffled on each run" << endl;
+int Sfann::num_workers(const variables_map & config, int num_tasks) {
+    int n = config["threads"].as<int>();
+    if (n > num_tasks) n = num_tasks;
+    return n < 1 ? 1 : n;
+}
+
+void Sfann::init_context(training_context & ctx, const variables_map & config, struct fann_train_data * train, struct fann_train_data * dev, struct fann_train_data * test, bool table) {
+    ctx.sfann = this;
+    ctx.config = &config;
+    ctx.seed = this->seed_of(config);
+    ctx.train = train;
+    ctx.dev = dev;
+    ctx.test = test;
+    ctx.late_data = false;
+    ctx.sparse_dev = NULL;
+    ctx.sparse_test = NULL;
+    ctx.sparse_sample = NULL;
+    ctx.inputs_encoded = false;
+    ctx.dev_sample = NULL;
+    ctx.best_sample = -1;
+    ctx.num_reports = 0;
+    ctx.eval_pending = false;
+    ctx.eval.net = NULL;
+    ctx.eval.threaded = false;
+    ctx.stream = this->stream;
+    ctx.res = create_training_res();
+    ctx.progress.run_start = 0;
+    ctx.progress.cv_start = 0;
+    ctx.progress.fold = 0;
+    ctx.progress.num_folds = 0;
+    ctx.progress.run = 0;
+    ctx.progress.num_runs = 0;
+    ctx.progress.train_time = 0;
+    ctx.progress.train_items = 0;
+    ctx.table = table;
+    ctx.pool = NULL;
+    ctx.task = 0;
+    ctx.best_dev = -1;
+    ctx.stale_reports = 0;
+    ctx.reference = NULL;
+    ctx.behind_reports = 0;
+    ctx.trace_epochs.clear();
+    ctx.trace_best.clear();
+}
+
+void Sfann::take_late_data(training_context * ctx) throw (SfannException) {
+    this->wait_data();
+    ctx->dev = this->dev_data;
+    ctx->test = this->test_data;
+    ctx->late_data = false;
+}
+
+training_res * Sfann::do_normal_training(const variables_map & config, struct fann_train_data * train, struct fann_train_data * dev, struct fann_train_data * test, int detail) {
+    int num_input = SfannSparse::num_inputs(train);
+    int num_output = fann_num_output_train_data(train);
+    int num_hidden = config["num-hidden"].as<int>();
+    int num_runs = config["num-runs"].as<int>();
+    bool randomize = config.count("randomize-data");
+    bool clever_init = config.count("clever-init");
+    bool table = config.count("verbose") && !config.count("no-table");
+    int behind = config["cancel-behind"].as<int>();
+    // 0 = permutation complete
+    unsigned int shuffle_block = 0;
+    if (config["shuffle-mode"].as<string>() == "block") {
+        shuffle_block = config.count("shuffle-block") ? config["shuffle-block"].as<int>() : default_shuffle_block(train);
+    }
+
+    // --trials-file : les runs de chaque essai, avec ses options (un seul essai sans le fichier)
+    vector<sfann_job> trials;
+    vector<variables_map *> configs;
+    this->read_trials(config, trials, configs);
+    int num_tasks = num_runs * configs.size();
+
+    // un seul flux de lecture en --stream-train : un run a la fois
+    int workers = this->stream != NULL ? 1 : this->num_workers(config, num_tasks);
+
+    if (detail > 0 && trials.empty()) cout << " ->  Network has 3 layers : " << num_input << "->" << num_hidden << "->" << num_output << endl;
+    if (detail > 0) cout << " ->  Training on " << train->num_data << " data (" << num_input << "->" << train->num_output << ")" << endl;
+    if (randomize && detail > 0 && shuffle_block == 0) cout << " ->  Training data are shuffled on each run" << endl;
+    if (randomize && detail > 0 && shuffle_block > 0) cout << " ->  Training data are shuffled on each run, by blocks of " << shuffle_block << " examples" << endl;
     if (clever_init && detail > 0) cout << " ->  Network weights are initialized using the Widrow + Nguyen's algorithm" << endl;
+    if (!trials.empty() && detail > 0) cout << " ->  " << trials.size() << " trials of " << num_runs << " runs" << endl;
+    if (workers > 1 && detail > 0) cout << " ->  " << num_tasks << " runs trained on " << workers << " threads" << endl;
+
+    // le dev et le test en cours de lecture : attendus au premier rapport d'un run seul, avant le depart de runs paralleles
+    bool late_data = false;
+    if (!this->loads.empty()) {
+        if (workers > 1) {
+            try {
+                this->wait_data();
+            } catch (SfannException & e) {
+                for (size_t c=0; c<configs.size(); c++) delete configs[c];
+                throw;
+            }
+            dev = this->dev_data;
+            test = this->test_data;
+        } else {
+            late_data = true;
+        }
+    }
+
+    // runs de chaque essai a la suite ; le premier est la reference de --cancel-behind
+    SfannTasks pool(workers);
+    vector<training_task> tasks(num_tasks);
+    for (int k=0; k<num_tasks; k++) {
+        training_task & t = tasks[k];
+        this->init_context(t.ctx, *configs[k / num_runs], train, dev, test, table && workers == 1);
+        t.ctx.late_data = late_data;
+        t.ctx.task = k;
+        t.ctx.progress.run = k;
+        t.ctx.progress.num_runs = num_tasks;
+        if (behind > 0 && k > 0) t.ctx.reference = &tasks[0].ctx;
+        t.detail = workers == 1 ? detail : 0;
+        t.cv_folds = NULL;
+        if (workers > 1) {
+            t.ctx.pool = &pool;
+            if (t.ctx.reference != NULL) pool.add(&t, 0);
+            else pool.add(&t);
+        }
+    }
+
+    string error;
+    if (workers > 1) {
+        try {
+            pool.run();
+        } catch (SfannException & e) {
+            error = e.what();
+        }
+    }
+
+    // agregation dans l'ordre des essais et des runs : le resultat ne depend pas du nombre de threads
+    // (avec un seul thread, chaque run est lance ici et son resultat affiche aussitot)
+    training_res * res = this->create_training_res();
+    for (int k=0; k<num_tasks; k++) {
+        if (!trials.empty() && k % num_runs == 0 && detail > 0 && error.empty()) {
+            cout << " ->  Trial " << trials[k / num_runs].name << " (network " << num_input << "->" << (*configs[k / num_runs])["num-hidden"].as<int>() << "->" << num_output << ")" << endl;
+        }
+        if (workers == 1 && error.empty()) {
+            try {
+                tasks[k].run(0);
+            } catch (SfannException & e) {
+                error = e.what();
+            }
+        }
+        this->merge_training_res(tasks[k].ctx.res, res);
+        this->delete_training_res(tasks[k].ctx.res, 1);
+        if (!error.empty()) continue;
+        if (detail > 0) {
+            if (workers > 1) cout << " ->  Iteration " << k << endl;
+            print_training_res(res);
+        }
+        log_training_res(res, -1, k);
+    }
+    for (size_t c=0; c<configs.size(); c++) delete configs[c];
+    if (!error.empty()) {
+        this->delete_training_res(res, 1);
+        throw SfannException(error);
+    }
 
-    this->train_courant = this->create_training_res();
+    if (detail > 0) printf("-> Training done !\n");
 
-/*    float somme_perfs = 0.;
-    int somme_num_ok = 0;*/
-    for (int k=0; k<num_runs; k++) {
+    return res;
+}
 
-        if (detail > 0) cout << " ->  Iteration " << k << endl;
+void training_task::run(unsigned int /*worker*/) throw (SfannException) {
+    Sfann * sfann = this->ctx.sfann;
+    train_dev_test_couple * cc = NULL;
+    if (this->cv_folds != NULL) {
+        SfannPerfScope perf_corpus("folds.corpus");
+        cc = create_train_dev_test_couple();
+        Sfann::generate_cross_corpus(this->cv_source, *this->cv_folds, cc, this->test_fold, this->nb_dev_folds);
+        perf_corpus.add_items(this->cv_folds->num_data);
+        perf_corpus.add_bytes_allocated(Sfann::view_size(this->cv_folds->num_data));
+        perf_corpus.stop();
 
+        this->ctx.train = cc->train;
+        this->ctx.dev = cc->dev->num_data > 0 ? cc->dev : NULL;
+        this->ctx.test = cc->test->num_data > 0 ? cc->test : NULL;
+    }
 
-/*        if (this->train_courant != NULL) {
-            this->delete_training_res(this->train_courant, 1);
-        }
+    sfann->train_run(&this->ctx, this->detail);
 
-        this->train_courant = this->create_training_res();
-*/
+    if (cc != NULL) {
+        this->ctx.train = NULL; this->ctx.dev = NULL; this->ctx.test = NULL;
+        SfannMemory::release(SFANN_MEM_FOLDS, Sfann::view_size(this->cv_folds->num_data));
+        Sfann::delete_train_dev_test_couple(cc, 1);
+    }
+}
 
+void Sfann::train_run(training_context * ctx, int detail) {
+    int k = ctx->progress.run;
+    int num_input = SfannSparse::num_inputs(ctx->train);
+    int num_output = fann_num_output_train_data(ctx->train);
+    int num_hidden = (*ctx->config)["num-hidden"].as<int>();
+    int max_epochs = (*ctx->config)["max-epoch"].as<int>();
+    int num_reports = (*ctx->config)["reports"].as<int>();
+    float desired_error = (*ctx->config)["desired-error"].as<float>();
+    bool randomize = (*ctx->config).count("randomize-data");
+    bool clever_init = (*ctx->config).count("clever-init");
+    // 0 = permutation complete
+    unsigned int shuffle_block = 0;
+    if ((*ctx->config)["shuffle-mode"].as<string>() == "block") {
+        shuffle_block = (*ctx->config).count("shuffle-block") ? (*ctx->config)["shuffle-block"].as<int>() : default_shuffle_block(ctx->train);
+    }
 
-// 		struct fann * net = fann_create_standard(3, num_input, num_output, num_hidden);
-        struct fann * net = fann_create_sparse(1.0, 3, num_input, num_hidden, num_output);
+    if (detail > 0) cout << " ->  Iteration " << k << endl;
 
-        fann_set_training_algorithm(net, FANN_TRAIN_RPROP);
+    SfannPerfScope perf_create("network.create");
+// 	struct fann * net = fann_create_standard(3, num_input, num_output, num_hidden);
+    struct fann * net = fann_create_sparse(1.0, 3, num_input, num_hidden, num_output);
 
-        fann_set_activation_function_hidden(net, FANN_SIGMOID_SYMMETRIC);
-        fann_set_activation_function_output(net, FANN_SIGMOID_SYMMETRIC);
+    fann_set_training_algorithm(net, FANN_TRAIN_RPROP);
 
-        fann_set_train_error_function(net, FANN_ERRORFUNC_LINEAR);
+    fann_set_activation_function_hidden(net, FANN_SIGMOID_SYMMETRIC);
+    fann_set_activation_function_output(net, FANN_SIGMOID_SYMMETRIC);
 
-        fann_set_train_stop_function(net, FANN_STOPFUNC_MSE);
+    fann_set_train_error_function(net, FANN_ERRORFUNC_LINEAR);
 
-        fann_set_learning_rate(net, 0.7);
-        fann_set_learning_momentum(net, 0.0);
+    fann_set_train_stop_function(net, FANN_STOPFUNC_MSE);
 
-        fann_set_activation_steepness_hidden(net,(fann_type) 0.5);
-        fann_set_activation_steepness_output(net,(fann_type) 0.5);
+    fann_set_learning_rate(net, 0.7);
+    fann_set_learning_momentum(net, 0.0);
 
-        fann_set_quickprop_decay(net, -0.0001);
-        fann_set_quickprop_mu(net, 1.75);
+    fann_set_activation_steepness_hidden(net,(fann_type) 0.5);
+    fann_set_activation_steepness_output(net,(fann_type) 0.5);
 
-        fann_set_rprop_increase_factor(net,1.2);
-        fann_set_rprop_decrease_factor(net,0.5);
-        fann_set_rprop_delta_min(net,0);
-        fann_set_rprop_delta_max(net,50);
+    fann_set_quickprop_decay(net, -0.0001);
+    fann_set_quickprop_mu(net, 1.75);
 
+    fann_set_rprop_increase_factor(net,1.2);
+    fann_set_rprop_decrease_factor(net,0.5);
+    fann_set_rprop_delta_min(net,0);
+    fann_set_rprop_delta_max(net,50);
 
-        if (randomize) {
-            fann_shuffle_train_data(this->train_data);
-        }
 
-        if (clever_init) {
-            fann_init_weights(net, this->train_data);
-        }
+    // le train partage n'est pas modifie : chaque run a sa propre permutation des exemples
+    struct fann_train_data * run_data = ctx->train;
+    if (randomize) {
+        SfannRandom run_rng(((unsigned long long)ctx->seed << 32) ^ ((unsigned long long)ctx->progress.fold << 16) ^ k);
+        SfannMemory::allocate(SFANN_MEM_DATASETS, view_size(ctx->train->num_data));
+        run_data = create_shuffled_view(ctx->train, run_rng, shuffle_block);
+    }
 
+    if (clever_init) {
+        fann_init_weights(net, run_data);
+    }
+    perf_create.stop();
 
-        fann_set_callback(net, training_callback);
+    // le dev et le test sont codes au premier rapport, le train (melange) est recode a chaque run
+    // en --stream-train, chaque bloc est code a sa lecture
+    sparse_inputs * sparse_train = ctx->stream == NULL ? encode_inputs(run_data, net, *ctx->config) : NULL;
+    if (k == 0 && detail > 0 && sparse_train != NULL) {
+        cout << " ->  Sparse inputs : " << sparse_train->binary_columns.size() << " of the " << num_input << " inputs are -1/1, "
+             << (run_data->num_data > 0 ? (float)sparse_train->active.size() / run_data->num_data : 0.f) << " set to 1 per example" << endl;
+    }
 
-        fann_train_on_data(net, this->train_data, max_epochs, num_reports, desired_error);
+    // training_callback et train_on_data retrouvent le run par le reseau
+    fann_set_user_data(net, ctx);
+    fann_set_callback(net, training_callback);
 
-        if (detail > 0) print_training_res(this->train_courant);
+    ctx->progress.run_start = SfannPerf::now();
+    ctx->progress.train_time = 0;
+    ctx->progress.train_items = 0;
+    ctx->best_dev = -1;
+    ctx->stale_reports = 0;
+    ctx->best_sample = -1;
+    ctx->num_reports = 0;
+    train_on_data(net, run_data, max_epochs, num_reports, desired_error, sparse_train);
+    release_inputs(sparse_train);
 
-        
+    // --async-eval : le dernier rapport compte aussi
+    if (ctx->eval_pending) this->finish_eval(ctx);
+
+    // sans rapport (--reports 0), le dev et le test n'ont pas encore ete attendus
+    if (ctx->late_data) this->take_late_data(ctx);
 
-// 		cout<<"Iteration " << k << " : score=" << score*100 << " best_dev=" << this->best_dev->dev_perfs << " " << endl;
+    // --dev-sample : le meilleur reseau sur le train a pu etre sauve sur un rapport sans evaluation complete
+    if (ctx->dev_sample != NULL) {
+        this->complete_net_carac(ctx, ctx->res->net_max_train);
+        SfannMemory::release(SFANN_MEM_DATASETS, view_size(ctx->dev_sample->num_data));
+        delete_view(ctx->dev_sample);
     }
 
-/*    res->avg_num_ok = somme_num_ok/num_runs;
-    res->avg_perfs = somme_perfs/num_runs;
+    release_inputs(ctx->sparse_sample);
+    release_inputs(ctx->sparse_dev);
+    release_inputs(ctx->sparse_test);
+    ctx->inputs_encoded = false;
 
-    res->num_data = this->dev_data->num_data;*/
+    // les meilleurs reseaux ont ete copies par training_callback
+    fann_destroy(net);
+    if (run_data != ctx->train) {
+        SfannMemory::release(SFANN_MEM_DATASETS, view_size(run_data->num_data));
+        delete_view(run_data);
+    }
+}
 
-    //if (detail > 0) printf(" => Globaf classif : max = %.2f %% ; avg = %.2f %%\n", res->max_perfs*100, res->avg_perfs*100);
+training_res * Sfann::do_fast_leave_one_out(const variables_map & config, int num_threads, unsigned int fine_tune_epochs) {
+    unsigned int num_data = this->train_data->num_data;
+
+    // reseau de reference, appris sur tout le train (sans dev ni test)
+    cout << " ->  Training the reference ANN on the " << num_data << " examples ... "; fflush(stdout);
+    training_res * reference = this->do_normal_training(config, this->train_data, NULL, NULL, 0);
+    cout << "Ok !" << endl;
+    printf("     - classif. rate of the reference ANN :\n");
+    print_training_res(reference);
+
+    if (reference->net_max_train == NULL || reference->net_max_train->net == NULL) {
+        this->delete_training_res(reference, 1);
+        throw SfannException("No reference ANN for the fast leave-one-out (is --reports greater than 0 ?)");
+    }
+
+    loo_job job;
+    job.reference = reference->net_max_train->net;
+    job.train = this->train_data;
+    job.fine_tune_epochs = fine_tune_epochs;
+    job.ok.assign(num_data, 0);
+    job.train_mse.assign(num_data, -1);
+
+    if (num_threads > (int)num_data) num_threads = num_data;
+    if (num_threads < 1) num_threads = 1;
+    job.nets.assign(num_threads, NULL);
+    job.views.assign(num_threads, NULL);
+    // chaque thread a sa copie du reseau et sa vue du train
+    SfannMemory::allocate(SFANN_MEM_SNAPSHOTS, net_size(job.reference) * num_threads);
+    SfannMemory::allocate(SFANN_MEM_FOLDS, view_size(num_data) * num_threads);
+
+    // une tache par bloc d'exemples ecartes, assez de blocs pour equilibrer les threads
+    unsigned int block = num_data / (num_threads * 16);
+    if (block < 1) block = 1;
+    vector<loo_task> tasks((num_data + block - 1) / block);
+    SfannTasks pool(num_threads);
+    for (size_t t=0; t<tasks.size(); t++) {
+        tasks[t].job = &job;
+        tasks[t].first = t * block;
+        tasks[t].count = min(block, num_data - tasks[t].first);
+        pool.add(&tasks[t]);
+    }
+
+    cout << " ->  Fine-tuning " << fine_tune_epochs << " epochs for each of the " << num_data << " left-out examples (" << num_threads << " threads) ... "; fflush(stdout);
+    SfannPerfScope perf("loo.folds");
+    string error;
+    try {
+        pool.run();
+    } catch (SfannException & e) {
+        error = e.what();
+    }
+    perf.add_items((unsigned long long)num_data * (num_data - 1) * fine_tune_epochs);
+    perf.stop();
+
+    for (int t=0; t<num_threads; t++) {
+        if (job.views[t] != NULL) delete_view(job.views[t]);
+        if (job.nets[t] != NULL) fann_destroy(job.nets[t]);
+    }
+    SfannMemory::release(SFANN_MEM_SNAPSHOTS, net_size(job.reference) * num_threads);
+    SfannMemory::release(SFANN_MEM_FOLDS, view_size(num_data) * num_threads);
+    if (!error.empty()) {
+        this->delete_training_res(reference, 1);
+        throw SfannException(error);
+    }
+    cout << "Ok !" << endl;
+
+    // agregation dans l'ordre des exemples, comme les folds du leave-one-out exact : l'exemple ecarte est le test du fold
+    training_res * res_global = this->create_training_res();
+    for (unsigned int i=0; i<num_data; i++) {
+        training_res * res = this->create_training_res();
+        res->net_max_train = create_empty_net_carac();
+        res->net_max_train->train_mse = job.train_mse[i];
+        res->net_max_train->train_num_data = num_data - 1;
+        res->net_max_train->test_num_ok = job.ok[i];
+        res->net_max_train->test_num_data = 1;
+        res->net_max_train->test_perfs = job.ok[i];
+        this->add_training_res(res, res_global);
+        this->delete_training_res(res, 1);
+    }
+
+    this->delete_training_res(reference, 1);
+    return res_global;
+}
 
-    if (detail > 0) printf("-> Training done !\n");
-    
-    training_res * res = this->train_courant;
-    this->train_courant = NULL;
+void loo_task::run(unsigned int worker) throw (SfannException) {
+    Sfann::loo_block(this->job, worker, this->first, this->count);
+}
 
-    return res;
+void Sfann::loo_block(loo_job * job, unsigned int worker, unsigned int first, unsigned int count) {
+    const struct fann * ref = job->reference;
+    unsigned int num_data = job->train->num_data;
+    unsigned int num_output = job->train->num_output;
+
+    if (job->nets[worker] == NULL) {
+        job->nets[worker] = fann_copy(ref);
+
+        vector<unsigned int> all(num_data);
+        for (unsigned int i=0; i<num_data; i++) all[i] = i;
+        job->views[worker] = create_view(job->train, all);
+    }
+    struct fann * net = job->nets[worker];
+    struct fann_train_data * view = job->views[worker];
+
+    for (unsigned int i=first; i<first+count; i++) {
+        // l'exemple i passe en derniere position : le train du fold est alors les num_data - 1 premiers
+        fann_type * tmp;
+        tmp = view->input[i]; view->input[i] = view->input[num_data-1]; view->input[num_data-1] = tmp;
+        tmp = view->output[i]; view->output[i] = view->output[num_data-1]; view->output[num_data-1] = tmp;
+        view->num_data = num_data - 1;
+
+        // repart des poids (et des pas du RPROP) du reseau de reference
+        memcpy(net->weights, ref->weights, ref->total_connections_allocated * sizeof(fann_type));
+        if (ref->train_slopes != NULL && ref->prev_steps != NULL && ref->prev_train_slopes != NULL && net->train_slopes != NULL && net->prev_steps != NULL && net->prev_train_slopes != NULL) {
+            memcpy(net->train_slopes, ref->train_slopes, ref->total_connections_allocated * sizeof(fann_type));
+            memcpy(net->prev_steps, ref->prev_steps, ref->total_connections_allocated * sizeof(fann_type));
+            memcpy(net->prev_train_slopes, ref->prev_train_slopes, ref->total_connections_allocated * sizeof(fann_type));
+        } else if (net->train_slopes != NULL) {
+            fann_clear_train_arrays(net);
+        }
+
+        float mse = -1;
+        for (unsigned int e=0; e<job->fine_tune_epochs; e++) {
+            fann_train_epoch(net, view);
+            mse = fann_get_MSE(net);
+        }
+
+        fann_type * out = fann_run(net, job->train->input[i]);
+        job->ok[i] = (max_struct(job->train->output[i], num_output) == max_struct(out, num_output));
+        job->train_mse[i] = mse;
+
+        view->num_data = num_data;
+        tmp = view->input[i]; view->input[i] = view->input[num_data-1]; view->input[num_data-1] = tmp;
+        tmp = view->output[i]; view->output[i] = view->output[num_data-1]; view->output[num_data-1] = tmp;
+    }
+}
+
+// meme boucle que fann_train_on_data, mais chaque epoque est chronometree
+void Sfann::train_on_data(struct fann * net, struct fann_train_data * data, unsigned int max_epochs, unsigned int epochs_between_reports, float desired_error, const sparse_inputs * sparse) {
+    training_context * ctx = (training_context *) fann_get_user_data(net);
+    for (unsigned int i = 1; i <= max_epochs; i++) {
+        double epoch_start = SfannPerf::now();
+        SfannPerfScope perf("train.epoch");
+        if (ctx->stream != NULL) {
+            ctx->stream->train_epoch(net, (*ctx->config)["input-encoding"].as<string>());
+            perf.add_bytes_read(ctx->stream->take_bytes_read());
+        } else if (sparse != NULL) {
+            SfannSparse::train_epoch(net, sparse);
+        } else {
+            SfannWeights::train_epoch(net, data);
+        }
+        perf.add_items(data->num_data);
+        perf.stop();
+        ctx->progress.train_time += SfannPerf::now() - epoch_start;
+        ctx->progress.train_items += data->num_data;
+
+        bool desired_error_reached;
+        if (fann_get_train_stop_function(net) == FANN_STOPFUNC_BIT) {
+            desired_error_reached = fann_get_bit_fail(net) <= desired_error;
+        } else {
+            desired_error_reached = fann_get_MSE(net) <= desired_error;
+        }
+
+        if (epochs_between_reports && (i % epochs_between_reports == 0 || i == max_epochs || i == 1 || desired_error_reached)) {
+            if (training_callback(net, data, max_epochs, epochs_between_reports, desired_error, i) == -1) {
+                break;
+            }
+        }
+
+        if (desired_error_reached) break;
+        // annule par le planificateur (erreur d'un autre run)
+        if (ctx->pool != NULL && ctx->pool->is_cancelled(ctx->task)) break;
+    }
 }
 
 
 
 
 
+
+sparse_inputs * Sfann::encode_inputs(const struct fann_train_data * data, const struct fann * net, const variables_map & config) throw (SfannException) {
+    string encoding = config["input-encoding"].as<string>();
+    if (data == NULL || data->num_data == 0) return NULL;
+
+    // les compartiments texte ne sont pas dans les entrees denses
+    bool text = SfannSparse::text_columns(data) > 0;
+    if (text && !SfannSparse::supports(net)) {
+        throw SfannException("The text parameters need an ANN in layers whose first hidden layer is fully connected to the inputs");
+    }
+    if (!text && (encoding == "dense" || !SfannSparse::supports(net))) return NULL;
+
+    SfannPerfScope perf("encode.sparse");
+    sparse_inputs * s = SfannSparse::encode(data);
+    perf.add_items(data->num_data);
+    if (!text && (s->binary_columns.empty() || (encoding == "auto" && !SfannSparse::worthwhile(s)))) {
+        SfannSparse::destroy(s);
+        return NULL;
+    }
+    perf.add_bytes_allocated(SfannSparse::size(s));
+    SfannMemory::allocate(SFANN_MEM_DATASETS, SfannSparse::size(s));
+    return s;
+}
+
+void Sfann::release_inputs(sparse_inputs * & s) {
+    if (s == NULL) return;
+    SfannMemory::release(SFANN_MEM_DATASETS, SfannSparse::size(s));
+    SfannSparse::destroy(s);
+}
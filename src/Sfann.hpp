@@ -41,15 +41,34 @@
 #include <algorithm>
 #include <vector>
 #include <map>
+#include <set>
 
 // pour random
 #include <cstdlib>
 #include <ctime>
 
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+
 #include <boost/program_options.hpp>
 #include "fann.h"
 #include "SfannException.hpp"
 #include "Icsiboost.hpp"
+#include "SfannModel.hpp"
+#include "SfannPerf.hpp"
+#include "SfannMemory.hpp"
+#include "SfannLog.hpp"
+#include "SfannRandom.hpp"
+#include "SfannSparse.hpp"
+#include "SfannBatch.hpp"
+#include "SfannWeights.hpp"
+#include "SfannFeatures.hpp"
+#include "SfannFolds.hpp"
+#include "SfannParse.hpp"
+#include "SfannStream.hpp"
+#include "SfannJobs.hpp"
+#include "SfannTasks.hpp"
 
 using namespace std;
 using namespace boost::program_options;
@@ -83,18 +102,150 @@ typedef struct train_dev_test_couple {
     struct fann_train_data * test;
 } train_dev_test_couple;
 
-typedef struct folds {
-    struct fann_train_data * data;
-    int num_folds;
-    int num_data;
-} folds;
-
 typedef struct training_res {
     net_carac * net_max_train;
     net_carac * net_max_dev;
     net_carac * net_max_test;
 } training_res;
 
+// avancement de l'apprentissage, pour les colonnes debit / ETA du tableau
+typedef struct training_progress {
+    // debut du run courant et de la validation croisee
+    double run_start;
+    double cv_start;
+    // fold courant, num_folds = 0 hors validation croisee
+    int fold;
+    int num_folds;
+    int run;
+    int num_runs;
+    // apprentissage depuis le dernier rapport
+    double train_time;
+    unsigned long long train_items;
+} training_progress;
+
+class Sfann;
+
+// un rapport a evaluer : le reseau lui-meme, ou sa copie avec --async-eval
+typedef struct report_eval {
+    struct fann * net;
+    unsigned int epochs;
+    unsigned int max_epochs;
+    float desired_error;
+    float train_mse;
+    unsigned int bit_fail;
+    // apprentissage depuis le rapport precedent
+    double train_time;
+    unsigned long long train_items;
+    // --async-eval : thread de l'evaluation, son verdict (1, ou -1 pour arreter le run) et son erreur
+    pthread_t thread;
+    bool threaded;
+    int result;
+    string error;
+} report_eval;
+
+// etat d'un apprentissage (un run), attache a son reseau par fann_set_user_data :
+// training_callback et train_on_data ne passent que par lui, plusieurs runs peuvent donc tourner en meme temps
+typedef struct training_context {
+    // codages et corpus partages (lecture seule pendant l'apprentissage)
+    Sfann * sfann;
+    // options du run : celles de la ligne de commande, ou celles de son experience avec --jobs-file
+    const variables_map * config;
+    // graine du run (voir seed_of)
+    unsigned int seed;
+    // corpus du run (vues d'un fold en validation croisee)
+    struct fann_train_data * train, * dev, * test;
+    // dev et test encore en lecture par load_data : repris de sfann au premier rapport
+    bool late_data;
+    // codages creux du dev et du test (NULL : entrees denses), faits au premier rapport
+    sparse_inputs * sparse_dev, * sparse_test;
+    // --dev-sample : echantillon stratifie du dev, evalue a chaque rapport (NULL sinon), et son codage creux
+    struct fann_train_data * dev_sample;
+    sparse_inputs * sparse_sample;
+    float best_sample;
+    bool inputs_encoded;
+    // rapports deja faits dans le run
+    int num_reports;
+    // dernier rapport, encore en evaluation si eval_pending (--async-eval)
+    report_eval eval;
+    bool eval_pending;
+    // --stream-train : le train n'est que l'en-tete du flux
+    SfannStream * stream;
+    // meilleurs reseaux du run
+    training_res * res;
+    training_progress progress;
+    // tableau des rapports, seulement quand un seul run tourne a la fois
+    bool table;
+    // tache du run, pour son annulation (pool NULL hors planificateur)
+    SfannTasks * pool;
+    unsigned int task;
+    // --cancel-patience : meilleur taux sur le dev et nombre de rapports sans amelioration
+    float best_dev;
+    int stale_reports;
+    // --cancel-behind : run de reference du fold (NULL pour la reference elle-meme), termine avant que ce run ne commence,
+    // et nombre de rapports de suite derriere lui
+    const training_context * reference;
+    int behind_reports;
+    // trace de la reference : meilleur taux sur le dev a l'epoque de chacun de ses rapports
+    vector<unsigned int> trace_epochs;
+    vector<float> trace_best;
+} training_context;
+
+// un run (fold, restart) : apprentissage simple ou validation croisee
+class training_task : public SfannTask {
+
+    public:
+        training_context ctx;
+        int detail;
+        // validation croisee : les vues du fold sont creees par la tache (cv_folds NULL sinon)
+        folds * cv_folds;
+        struct fann_train_data * cv_source;
+        int test_fold;
+        int nb_dev_folds;
+
+        void run(unsigned int worker) throw (SfannException);
+};
+
+// leave-one-out rapide : donnees partagees par les taches
+typedef struct loo_job {
+    // reseau appris sur tout le train, point de depart de chaque fold
+    struct fann * reference;
+    struct fann_train_data * train;
+    unsigned int fine_tune_epochs;
+    // copie du reseau et vue du train de chaque thread, creees a sa premiere tache
+    vector<struct fann *> nets;
+    vector<struct fann_train_data *> views;
+    // resultats par exemple ecarte
+    vector<char> ok;
+    vector<float> train_mse;
+} loo_job;
+
+// leave-one-out rapide : les exemples first .. first + count - 1 ecartes tour a tour
+class loo_task : public SfannTask {
+
+    public:
+        loo_job * job;
+        unsigned int first;
+        unsigned int count;
+
+        void run(unsigned int worker) throw (SfannException);
+};
+
+// lecture d'un corpus par un thread (le dev et le test pendant la lecture du train)
+typedef struct data_load {
+    string file;
+    // schema Icsiboost partage, NULL pour le format FANN
+    IcsiboostNames * names;
+    string phase;
+    // corpus a remplir une fois la lecture terminee
+    struct fann_train_data ** target;
+    // resultat du thread
+    struct fann_train_data * data;
+    string error;
+    double seconds;
+    pthread_t thread;
+    bool threaded;
+} data_load;
+
 
 class Sfann {
 
@@ -104,27 +255,52 @@ class Sfann {
 
         options_description * options;
         variables_map * config;
+        // arguments de la ligne de commande, repris par chaque experience de --jobs-file
+        vector<string> args;
+        vector<sfann_job> jobs;
         struct fann_train_data *train_data, *dev_data, *test_data;
-
-        training_res * train_courant;
+        // train complet lorsque train_data et dev_data en sont des vues (--auto-dev)
+        struct fann_train_data * train_source;
+        // --stream-train : train lu par blocs, train_data n'en est alors que l'en-tete (sans exemples)
+        SfannStream * stream;
+        // --prune-inputs : colonnes gardees, appliquees au train, au dev et au test (NULL sinon)
+        feature_map * features;
+
+        // graine de --seed (ou de l'horloge) et generateur utilise pour les tirages
+        unsigned int seed;
+        SfannRandom rng;
+
+        // schema du .names, lu une fois et partage par les lectures du train, du dev et du test
+        IcsiboostNames * names;
+        // lectures en cours en arriere-plan, terminees par wait_data
+        vector<data_load *> loads;
 
         static int max_struct(fann_type* output, int number);
         static void print_map(map<int, int> & m);
         static int max_struct(map<int, int> & output);
-        static int perfs_on_data(struct fann * net, struct fann_train_data *data);
-        static void perfs_on_data(struct fann * net, struct fann_train_data * data, int & nb_bons, fann_type ** & res);
+        static int perfs_on_data(struct fann * net, struct fann_train_data *data, const sparse_inputs * sparse = NULL);
+        static void perfs_on_data(struct fann * net, struct fann_train_data * data, int & nb_bons, fann_type ** & res, const sparse_inputs * sparse = NULL, float * mse = NULL);
         static void print_net_carac(net_carac * nc);
         static void print_training_res(training_res * t);
+        // ecrit les meilleurs reseaux de <t> dans le journal (fold/run < 0 pour un resultat global)
+        static void log_training_res(training_res * t, int fold, int run);
         // oprateurs scuriss
         template <class T> static float divide_values(T a, T b);
         template <class T> static T multiply_values(T a, T b);
         template <class T> static T add_values(T a, T b);
         static void add_net_carac(net_carac * src, net_carac * & dest);
         static void add_training_res(training_res * src, training_res * dest);
+        // garde dans <dest> les meilleurs reseaux de <src> (a egalite ceux de <dest>), et vide <src>
+        static void merge_training_res(training_res * src, training_res * dest);
         static void delete_fann_train_data(struct fann_train_data * & d, int nb);
 
         // callback FANN
         static int FANN_API training_callback(struct fann *ann, struct fann_train_data *train,unsigned int max_epochs, unsigned int epochs_between_reports,float desired_error, unsigned int epochs);
+        // evaluation du rapport ctx->eval (dev, test, meilleurs reseaux, tableau et journal) ; -1 pour arreter le run
+        static int evaluate_report(training_context * ctx);
+        // --async-eval : thread d'evaluation, et attente de son verdict
+        static void * eval_worker(void * ctx);
+        static int finish_eval(training_context * ctx) throw (SfannException);
         // clone deux FANN
         template <class T> static T ** copy_matrix(T ** m, int x, int y);
         template <class T> static void delete_matrix(T ** & m, int x, int y);
@@ -136,18 +312,34 @@ class Sfann {
         static void copy_train_data(struct fann_train_data * src, struct fann_train_data * dest);
         // ajoute les <nb> donnes de <src> a partir de <start> vers <dest>
         static void copy_train_data(struct fann_train_data * src, struct fann_train_data * dest, int start, int nb);
-        // genere le couple train/dev <cross_corpus> en prenant le fold <num_fold> comme dev et le reste comme train
-        static void generate_cross_corpus(folds & _folds, train_dev_test_couple * cross_corpus, int num_test_fold, int nb_dev_folds);
-
-        // lance la boucle d'apprentissage norale
-        training_res * do_normal_training(int detail);
+        // genere le triplet de vues <cross_corpus> : le fold <num_test_fold> comme test, les <nb_dev_folds> suivants comme dev et le reste comme train
+        static void generate_cross_corpus(struct fann_train_data * train_data, folds & _folds, train_dev_test_couple * cross_corpus, int num_test_fold, int nb_dev_folds);
+
+        // lance les runs (--num-runs) sur <train>, <dev> et <test>, en parallele selon --threads
+        training_res * do_normal_training(const variables_map & config, struct fann_train_data * train, struct fann_train_data * dev, struct fann_train_data * test, int detail);
+        // contexte d'un run sur ces corpus
+        void init_context(training_context & ctx, const variables_map & config, struct fann_train_data * train, struct fann_train_data * dev, struct fann_train_data * test, bool table);
+        // un run : cree le reseau et l'entraine, ses meilleurs reseaux restent dans ctx->res
+        void train_run(training_context * ctx, int detail);
+        // --dev-sample : vue sur un echantillon stratifie de <dev>, NULL si l'option n'est pas donnee ou si le dev est plus petit
+        struct fann_train_data * create_dev_sample(training_context * ctx);
+        // evalue sur le dev et le test entiers une sauvegarde faite sur un rapport sans evaluation complete
+        void complete_net_carac(training_context * ctx, net_carac * nc);
+        // attend le dev et le test lus en arriere-plan et les donne au run
+        void take_late_data(training_context * ctx) throw (SfannException);
+        // nombre de threads pour <num_tasks> taches (--threads)
+        int num_workers(const variables_map & config, int num_tasks);
+        // leave-one-out rapide : un reseau de reference sur tout le train, puis un court reapprentissage par exemple ecarte
+        training_res * do_fast_leave_one_out(const variables_map & config, int num_threads, unsigned int fine_tune_epochs);
+        static void loo_block(loo_job * job, unsigned int worker, unsigned int first, unsigned int count);
+        // equivalent de fann_train_on_data, avec mesure du temps de chaque epoque
+        static void train_on_data(struct fann * net, struct fann_train_data * data, unsigned int max_epochs, unsigned int epochs_between_reports, float desired_error, const sparse_inputs * sparse);
+        // codage creux de <data> selon --input-encoding, NULL si les entrees restent denses (toujours fait pour les entrees texte)
+        sparse_inputs * encode_inputs(const struct fann_train_data * data, const struct fann * net, const variables_map & config) throw (SfannException);
+        static void release_inputs(sparse_inputs * & s);
 
-        // coupe le corpus de train en cross_nb_folds parties (folds) et met le resultat dans _folds
-        static void generate_folds_from_train_corpus(struct fann_train_data * train_data, folds & _folds, int cross_nb_folds);
         // libere un tableau de train_dev_couple
         static void delete_train_dev_test_couple(train_dev_test_couple * & cross_corpora, int nb_corpora);
-        // libere un folds
-        static  void delete_folds(folds * & f);
 
         static void delete_training_res(training_res * & t, int nb);
 
@@ -156,15 +348,73 @@ class Sfann {
         static net_carac * create_empty_net_carac();
         static training_res * create_training_res();
 
-        static void create_dev_from_train_corpus(struct fann_train_data * & _dev_data, struct fann_train_data * & _train_data, const struct fann_train_data * _test_data, int dev_size) throw (SfannException);
+        static void create_dev_from_train_corpus(struct fann_train_data * & _dev_data, struct fann_train_data * & _train_data, const struct fann_train_data * _test_data, int dev_size, SfannRandom & rng) throw (SfannException);
+        // range les indices des exemples de <data> par classe
+        static void class_index(const struct fann_train_data * data, vector< vector<unsigned int> > & by_class);
+        // vue sur les exemples <indices> de <src> : les exemples ne sont pas copies, <src> doit rester alloue
+        static struct fann_train_data * create_view(const struct fann_train_data * src, const vector<unsigned int> & indices);
+        static void delete_view(struct fann_train_data * & view);
+        // vue de <src> dans un ordre aleatoire ; si <block> > 0, seuls l'ordre des blocs de <block> exemples et l'ordre dans chaque bloc changent
+        static struct fann_train_data * create_shuffled_view(const struct fann_train_data * src, SfannRandom & rng, unsigned int block);
+        static unsigned int default_shuffle_block(const struct fann_train_data * data);
 
         static bool is_readable(const string & file);
+        static unsigned long long file_size(const string & file);
+        // taille memoire des exemples de <data>
+        static unsigned long long data_size(const struct fann_train_data * data);
+        // taille memoire de <num_data> exemples au format de <model>
+        static unsigned long long data_size(const struct fann_train_data * model, unsigned int num_data);
+        // taille memoire d'une matrice de sorties (x lignes de y valeurs)
+        static unsigned long long matrix_size(int x, int y);
+        // taille memoire d'une vue de <num_data> exemples
+        static unsigned long long view_size(unsigned int num_data);
+        // taille memoire d'un reseau, et d'un reseau sauvegarde avec ses sorties
+        static unsigned long long net_size(const struct fann * net);
+        static unsigned long long net_carac_size(const net_carac * nc);
+        // taille memoire de fann_copy(<net>) (connexions allouees au plus juste)
+        static unsigned long long copy_size(const struct fann * net);
+        // taille de la sauvegarde de <ann> avec ses sorties sur le dev et le test, a reserver avant de la copier
+        static unsigned long long snapshot_size(training_context * ctx, const struct fann * ann, bool dev, bool test);
+        // fann_copy dont la place <reserved> est deja comptee dans SFANN_MEM_SNAPSHOTS (rendue si la copie echoue)
+        static struct fann * snapshot_copy(const struct fann * ann, unsigned long long reserved) throw (SfannException);
+        // duree au format h:mm:ss
+        static string format_duration(double seconds);
+        static struct fann_train_data * read_data_file(const string & file, IcsiboostNames * names, const string & phase) throw (SfannException);
+        // lecture seule, sans compte du temps ni de la memoire (appelable depuis un thread)
+        static struct fann_train_data * parse_data_file(const string & file, IcsiboostNames * names) throw (SfannException);
+        static void * load_worker(void * load);
+        // lit <file> dans *<target> en arriere-plan
+        void start_load(const string & file, const string & phase, struct fann_train_data ** target);
+        // SfannFeatures::project, la place du corpus projete etant reservee avant son allocation
+        static struct fann_train_data * project_data(const struct fann_train_data * data, const feature_map & map) throw (SfannException);
+        // SfannModel::save, avec la projection des entrees a cote du modele
+        void save_model(struct fann * net, const string & file, bool binary) throw (SfannException);
+
+        // options d'une experience de --jobs-file : les siennes, puis celles de la ligne de commande
+        variables_map * job_config(const sfann_job & job) throw (SfannException);
+        // execute une experience dans le processus fils (voir SfannJobs)
+        static int run_job(const sfann_job & job);
+        // --trials-file : options de chaque essai (les siennes, puis celles de <config>) ; sans le fichier, une copie de <config>
+        void read_trials(const variables_map & config, vector<sfann_job> & trials, vector<variables_map *> & configs) throw (SfannException);
+        // graine d'une experience : son --seed, sinon celle de la ligne de commande
+        unsigned int seed_of(const variables_map & config);
+
+        // une experience avec ses options : celles de la ligne de commande (this->config), ou celles de job_config,
+        // passees jusqu'au contexte de chaque run sans jamais remplacer this->config
+        void check_options(const variables_map & config) throw (SfannException);
+        // options impossibles avec les parametres texte du .names, dont les compartiments ne passent que par les noyaux creux
+        void check_text_options(const variables_map & config) throw (SfannException);
+        void do_training(const variables_map & config);
+        void write_perf_report(const variables_map & config) throw (SfannException);
         
 // 		static net_carac * best_dev;
 // 		static net_carac * best_train;
 
         static Sfann * me;
 
+        friend class loo_task;
+        friend class training_task;
+
 
     public:
         static void print_fann_train_data(struct fann_train_data * data);
@@ -177,6 +427,9 @@ class Sfann {
         // lance l'apprentissage (main)
         void do_training();
         void load_data() throw (SfannException);
+        // attend les lectures lancees par load_data (exception si l'une a echoue)
+        void wait_data() throw (SfannException);
+        void write_perf_report() throw (SfannException);
         void usage();
 };
 
@@ -0,0 +1,159 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+
+#include "SfannBatch.hpp"
+
+#include <cmath>
+
+
+static bool is_supported_activation(unsigned int activation_function) {
+    return activation_function == FANN_LINEAR || activation_function == FANN_SIGMOID || activation_function == FANN_SIGMOID_SYMMETRIC;
+}
+
+// somme ponderee d'un neurone, dans l'ordre des additions de fann_run (le reste d'abord, puis par quatre)
+static inline fann_type weighted_sum(const fann_type * w, const fann_type * v, unsigned int n) {
+    fann_type sum = 0;
+    unsigned int i = n & 3;
+    // le reste du dernier au premier, comme le switch de fann_run
+    for (unsigned int j = i; j > 0; j--) {
+        sum += w[j-1] * v[j-1];
+    }
+    for (; i != n; i += 4) {
+        sum += w[i] * v[i] + w[i+1] * v[i+1] + w[i+2] * v[i+2] + w[i+3] * v[i+3];
+    }
+    return sum;
+}
+
+// fin du calcul d'un neurone, comme dans fann_run (les fonctions de FANN sont calculees en double)
+static inline fann_type activation(unsigned int activation_function, fann_type steepness, fann_type sum) {
+    fann_type max_sum = 150 / steepness;
+    sum = sum * steepness;
+    if (sum > max_sum) sum = max_sum;
+    else if (sum < -max_sum) sum = -max_sum;
+
+    switch (activation_function) {
+        case FANN_SIGMOID:
+            return (fann_type)(1.0 / (1.0 + exp((double)(-2.0f * sum))));
+        case FANN_SIGMOID_SYMMETRIC:
+            return (fann_type)(2.0 / (1.0 + exp((double)(-2.0f * sum))) - 1.0);
+        default:
+            return sum;
+    }
+}
+
+
+bool SfannBatch::supports(const struct fann * net) {
+    if (net == NULL || net->network_type != FANN_NETTYPE_LAYER || net->connection_rate < 1) return false;
+
+    for (struct fann_layer * layer = net->first_layer + 1; layer != net->last_layer; ++layer) {
+        struct fann_layer * prev = layer - 1;
+        unsigned int prev_size = prev->last_neuron - prev->first_neuron;
+        for (struct fann_neuron * neuron = layer->first_neuron; neuron != layer->last_neuron; ++neuron) {
+            if (neuron->first_con == neuron->last_con) continue;
+            if (!is_supported_activation(neuron->activation_function)) return false;
+            // tous les neurones de la couche precedente (biais compris), dans l'ordre
+            if (neuron->last_con - neuron->first_con != prev_size || net->connections[neuron->first_con] != prev->first_neuron) return false;
+        }
+    }
+    return true;
+}
+
+void SfannBatch::run(const struct fann * net, fann_type * const * input, unsigned int count, fann_type ** output, vector<fann_type> & buffer) {
+    // deux couches consecutives, chacune en <count> lignes de <stride> valeurs
+    unsigned int stride = 0;
+    for (struct fann_layer * layer = net->first_layer; layer != net->last_layer; ++layer) {
+        unsigned int size = layer->last_neuron - layer->first_neuron;
+        if (size > stride) stride = size;
+    }
+    if (buffer.size() < 2 * SFANN_BATCH_SIZE * stride) buffer.resize(2 * SFANN_BATCH_SIZE * stride);
+    fann_type * prev = &buffer[0];
+    fann_type * cur = prev + SFANN_BATCH_SIZE * stride;
+
+    // couche d'entree : les entrees puis le biais
+    unsigned int num_input = net->num_input;
+    unsigned int input_size = net->first_layer->last_neuron - net->first_layer->first_neuron;
+    for (unsigned int b=0; b<count; b++) {
+        fann_type * row = prev + b * stride;
+        for (unsigned int k=0; k<num_input; k++) row[k] = input[b][k];
+        for (unsigned int k=num_input; k<input_size; k++) row[k] = 1;
+    }
+
+    for (struct fann_layer * layer = net->first_layer + 1; layer != net->last_layer; ++layer) {
+        unsigned int size = layer->last_neuron - layer->first_neuron;
+        for (unsigned int j=0; j<size; j++) {
+            const struct fann_neuron * neuron = layer->first_neuron + j;
+            if (neuron->first_con == neuron->last_con) {
+                // biais
+                for (unsigned int b=0; b<count; b++) cur[b * stride + j] = 1;
+                continue;
+            }
+            // les poids du neurone servent a tout le bloc
+            const fann_type * w = net->weights + neuron->first_con;
+            unsigned int num_connections = neuron->last_con - neuron->first_con;
+            for (unsigned int b=0; b<count; b++) {
+                fann_type sum = weighted_sum(w, prev + b * stride, num_connections);
+                cur[b * stride + j] = activation(neuron->activation_function, neuron->activation_steepness, sum);
+            }
+        }
+        fann_type * tmp = prev; prev = cur; cur = tmp;
+    }
+
+    for (unsigned int b=0; b<count; b++) {
+        const fann_type * row = prev + b * stride;
+        for (unsigned int k=0; k<net->num_output; k++) output[b][k] = row[k];
+    }
+}
+
+void SfannBatch::add_squared_error(const struct fann * net, const fann_type * desired, const fann_type * output, float & sum) {
+    const struct fann_neuron * last = (net->last_layer - 1)->first_neuron;
+    for (unsigned int k=0; k<net->num_output; k++) {
+        fann_type diff = desired[k] - output[k];
+        // comme fann_update_MSE : l'erreur des sorties symetriques est ramenee a [-1, 1]
+        switch (last[k].activation_function) {
+            case FANN_LINEAR_PIECE_SYMMETRIC:
+            case FANN_THRESHOLD_SYMMETRIC:
+            case FANN_SIGMOID_SYMMETRIC:
+            case FANN_SIGMOID_SYMMETRIC_STEPWISE:
+            case FANN_ELLIOT_SYMMETRIC:
+            case FANN_GAUSSIAN_SYMMETRIC:
+            case FANN_SIN_SYMMETRIC:
+            case FANN_COS_SYMMETRIC:
+                diff /= 2.0;
+                break;
+            default:
+                break;
+        }
+        sum += (float)(diff * diff);
+    }
+}
@@ -0,0 +1,65 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNBATCH__
+#define __LIB_SFANNBATCH__
+
+#include <vector>
+#include "fann.h"
+
+using namespace std;
+
+// nombre d'exemples passes ensemble dans chaque couche
+#define SFANN_BATCH_SIZE 64
+
+
+// Evaluation par blocs d'exemples.
+//
+// fann_run parcourt tout le reseau pour chaque exemple et relit donc tous
+// les poids a chaque fois. Ici chaque couche est calculee pour un bloc
+// d'exemples : les poids d'un neurone restent en cache pendant qu'ils sont
+// appliques a tous les exemples du bloc. Les sommes sont faites dans l'ordre
+// de fann_run, les sorties sont donc exactement les siennes.
+class SfannBatch {
+
+    public:
+        // reseau en couches completement connectees, fonctions d'activation de sfann
+        static bool supports(const struct fann * net);
+        // sorties du reseau pour les <count> (au plus SFANN_BATCH_SIZE) exemples <input>, copiees dans output[0..count-1] ;
+        // <buffer> garde les valeurs des couches d'un appel a l'autre
+        static void run(const struct fann * net, fann_type * const * input, unsigned int count, fann_type ** output, vector<fann_type> & buffer);
+        // ajoute a <sum> l'erreur quadratique d'un exemple, comme fann_compute_MSE (moyenne : sum / nombre d'exemples)
+        static void add_squared_error(const struct fann * net, const fann_type * desired, const fann_type * output, float & sum);
+};
+
+#endif
@@ -0,0 +1,164 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannFeatures.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <stdint.h>
+
+#define SFANN_FEATURES_MAGIC "sfann-features"
+
+
+// empreinte d'une valeur, 0 et -0 confondus
+static inline uint32_t value_bits(fann_type v) {
+    if (v == 0) v = 0;
+    float f = (float)v;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+feature_map SfannFeatures::analyze(const struct fann_train_data * data, unsigned int & num_constant, unsigned int & num_duplicate) {
+    unsigned int num_input = data->num_input;
+    unsigned int num_data = data->num_data;
+    feature_map map;
+    map.num_input = num_input;
+    num_constant = 0;
+    num_duplicate = 0;
+
+    // une seule passe sur les exemples : colonnes constantes et empreinte (FNV-1a) de chaque colonne
+    vector<char> constant(num_input, num_data > 0);
+    vector<uint64_t> hash(num_input, 14695981039346656037ULL);
+    const fann_type * first = num_data > 0 ? data->input[0] : NULL;
+    for (unsigned int i=0; i<num_data; i++) {
+        const fann_type * in = data->input[i];
+        for (unsigned int c=0; c<num_input; c++) {
+            if (in[c] != first[c]) constant[c] = 0;
+            hash[c] = (hash[c] ^ value_bits(in[c])) * 1099511628211ULL;
+        }
+    }
+
+    // colonnes de meme empreinte comparees exemple par exemple ; la premiere de chaque groupe est gardee
+    vector< pair<uint64_t, unsigned int> > order;
+    for (unsigned int c=0; c<num_input; c++) {
+        if (constant[c]) num_constant++;
+        else order.push_back(make_pair(hash[c], c));
+    }
+    sort(order.begin(), order.end());
+    vector<char> duplicate(num_input, 0);
+    for (size_t a=0; a<order.size(); a++) {
+        unsigned int ca = order[a].second;
+        if (duplicate[ca]) continue;
+        for (size_t b=a+1; b<order.size() && order[b].first == order[a].first; b++) {
+            unsigned int cb = order[b].second;
+            if (duplicate[cb]) continue;
+            unsigned int i = 0;
+            while (i < num_data && data->input[i][ca] == data->input[i][cb]) i++;
+            if (i == num_data) {
+                duplicate[cb] = 1;
+                num_duplicate++;
+            }
+        }
+    }
+
+    for (unsigned int c=0; c<num_input; c++) {
+        if (!constant[c] && !duplicate[c]) map.kept.push_back(c);
+    }
+    // un reseau a au moins une entree
+    if (map.kept.empty() && num_input > 0) {
+        map.kept.push_back(0);
+        num_constant--;
+    }
+    return map;
+}
+
+struct fann_train_data * SfannFeatures::project(const struct fann_train_data * data, const feature_map & map) throw (SfannException) {
+    if (data->num_input != map.num_input) {
+        ostringstream oss;
+        oss << "The data have " << data->num_input << " inputs, the input projection expects " << map.num_input << " !";
+        throw SfannException(oss.str());
+    }
+    unsigned int num_kept = map.kept.size();
+    struct fann_train_data * res = fann_create_train(data->num_data, num_kept, data->num_output);
+    if (res == NULL) {
+        throw SfannException("Impossible allocation of the projected examples !");
+    }
+    for (unsigned int i=0; i<data->num_data; i++) {
+        const fann_type * in = data->input[i];
+        fann_type * out = res->input[i];
+        for (unsigned int k=0; k<num_kept; k++) out[k] = in[map.kept[k]];
+        memcpy(res->output[i], data->output[i], data->num_output * sizeof(fann_type));
+    }
+    return res;
+}
+
+void SfannFeatures::save(const feature_map & map, const string & file) throw (SfannException) {
+    ofstream out(file.c_str());
+    if (!out) {
+        throw SfannException("Impossible write of " + file + " !");
+    }
+    out << SFANN_FEATURES_MAGIC << " " << map.num_input << " " << map.kept.size() << endl;
+    for (size_t k=0; k<map.kept.size(); k++) {
+        out << (k > 0 ? " " : "") << map.kept[k];
+    }
+    out << endl;
+    out.close();
+    if (!out) {
+        throw SfannException("Error while writing " + file + " !");
+    }
+}
+
+bool SfannFeatures::load(const string & file, feature_map & map) throw (SfannException) {
+    ifstream in(file.c_str());
+    if (!in) return false;
+
+    string magic;
+    size_t num_kept = 0;
+    in >> magic >> map.num_input >> num_kept;
+    if (!in || magic != SFANN_FEATURES_MAGIC) {
+        throw SfannException("Bad input projection file " + file + " !");
+    }
+    map.kept.clear();
+    for (size_t k=0; k<num_kept; k++) {
+        unsigned int c;
+        if (!(in >> c) || c >= map.num_input || (k > 0 && c <= map.kept.back())) {
+            throw SfannException("Bad input projection file " + file + " !");
+        }
+        map.kept.push_back(c);
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNFEATURES__
+#define __LIB_SFANNFEATURES__
+
+#include <string>
+#include <vector>
+#include "fann.h"
+#include "SfannException.hpp"
+
+using namespace std;
+
+
+// Projection des entrees (--prune-inputs).
+//
+// Les colonnes constantes du train (valeurs d'etiquette jamais vues, valeurs
+// toujours absentes, parametres continus fixes) et les copies exactes d'une
+// colonne precedente n'apportent rien au reseau : elles sont retirees avant
+// l'apprentissage. La projection est enregistree a cote du modele
+// (<modele>.features) pour que --do-running l'applique aux nouveaux corpus.
+typedef struct feature_map {
+    // nombre d'entrees du corpus d'origine
+    unsigned int num_input;
+    // colonnes gardees, dans l'ordre du corpus d'origine
+    vector<unsigned int> kept;
+} feature_map;
+
+
+class SfannFeatures {
+
+    public:
+        // colonnes de <data> qui ne sont ni constantes ni la copie d'une colonne precedente
+        static feature_map analyze(const struct fann_train_data * data, unsigned int & num_constant, unsigned int & num_duplicate);
+        // nouveau corpus reduit aux colonnes gardees (<data> reste alloue)
+        static struct fann_train_data * project(const struct fann_train_data * data, const feature_map & map) throw (SfannException);
+
+        static void save(const feature_map & map, const string & file) throw (SfannException);
+        // faux si <file> n'existe pas
+        static bool load(const string & file, feature_map & map) throw (SfannException);
+        // fichier de la projection du modele <model>
+        static string file_of(const string & model) {return model + ".features";};
+};
+
+#endif
@@ -0,0 +1,65 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannFolds.hpp"
+
+#include <algorithm>
+
+
+void SfannFolds::stratify(const vector< vector<unsigned int> > & by_class, folds & _folds, int num_folds, SfannRandom * rng) {
+    _folds.indices.assign(num_folds, vector<unsigned int>());
+    _folds.num_folds = num_folds;
+
+    // le compteur continue d'une classe a l'autre pour que les folds restent de meme taille
+    int pos = 0;
+    vector<unsigned int> shuffled;
+    for (size_t c=0; c<by_class.size(); c++) {
+        const vector<unsigned int> * indices = &by_class[c];
+        if (rng != NULL) {
+            shuffled = by_class[c];
+            rng->shuffle(shuffled);
+            indices = &shuffled;
+        }
+        for (size_t k=0; k<indices->size(); k++) {
+            _folds.indices[pos].push_back((*indices)[k]);
+            if (++pos >= num_folds) pos = 0;
+        }
+    }
+
+    _folds.num_data = 0;
+    for (int i=0; i<num_folds; i++) {
+        // ordre du corpus, pour parcourir les exemples sequentiellement
+        sort(_folds.indices[i].begin(), _folds.indices[i].end());
+        _folds.num_data += _folds.indices[i].size();
+    }
+}
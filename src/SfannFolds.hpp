@@ -0,0 +1,66 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNFOLDS__
+#define __LIB_SFANNFOLDS__
+
+#include <vector>
+#include "SfannRandom.hpp"
+
+using namespace std;
+
+
+typedef struct folds {
+    // indices des exemples de chaque fold dans le corpus de train
+    vector< vector<unsigned int> > indices;
+    int num_folds;
+    int num_data;
+} folds;
+
+
+// Folds stratifies de la validation croisee.
+//
+// Les indices des exemples sont ranges par classe une seule fois pour toutes
+// les repetitions : chaque repetition melange sa propre copie, si bien que les
+// folds d'une repetition ne dependent que de sa graine et peuvent etre rejoues
+// seuls (--seed <graine de la repetition>).
+class SfannFolds {
+
+    public:
+        // Repartit les exemples de chaque classe (<by_class>) a tour de role entre <num_folds> folds : chaque fold a (a un
+        // exemple pres) la meme proportion de chaque classe que le train. Si <rng> n'est pas NULL, les exemples de chaque
+        // classe sont d'abord melanges.
+        static void stratify(const vector< vector<unsigned int> > & by_class, folds & _folds, int num_folds, SfannRandom * rng);
+};
+
+#endif
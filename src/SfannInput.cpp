@@ -0,0 +1,385 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "SfannInput.hpp"
+
+#include <cstring>
+#include <sstream>
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+// anneau de 4 blocs de 1 Mo : le thread a toujours de l'avance sur l'analyse
+static const size_t num_chunks = 4;
+static const size_t chunk_size = 1 << 20;
+// lectures sur le disque des decodeurs
+static const size_t raw_buffer_size = 256 * 1024;
+static const size_t line_buffer_size = 64 * 1024;
+
+
+// Decompression d'un fichier, appelee par le thread de SfannInput
+class SfannDecoder {
+
+    protected:
+        SfannInput * input;
+        vector<char> raw;
+
+        size_t read_raw(char * buf, size_t n) {return this->input->read_raw(buf, n);};
+
+        void fail(const string & what) throw (SfannException) {
+            throw SfannException("Error in " + this->input->file + " : " + what);
+        }
+
+    public:
+        SfannDecoder(SfannInput * input) {
+            this->input = input;
+            this->raw.resize(raw_buffer_size);
+        }
+        virtual ~SfannDecoder() {}
+
+        // remplit au plus <n> octets de <out>, 0 a la fin des donnees
+        virtual size_t decode(char * out, size_t n) throw (SfannException) = 0;
+};
+
+
+#ifdef HAVE_LIBZ
+class SfannGzipDecoder : public SfannDecoder {
+
+    private:
+        z_stream zs;
+        bool ended;
+
+    public:
+        SfannGzipDecoder(SfannInput * input) throw (SfannException) : SfannDecoder(input) {
+            memset(&this->zs, 0, sizeof(this->zs));
+            // 15 + 32 : en-tete gzip ou zlib reconnu par zlib
+            if (inflateInit2(&this->zs, 15 + 32) != Z_OK) {
+                this->fail("impossible initialization of zlib");
+            }
+            this->ended = false;
+        }
+
+        ~SfannGzipDecoder() {
+            inflateEnd(&this->zs);
+        }
+
+        size_t decode(char * out, size_t n) throw (SfannException) {
+            this->zs.next_out = (Bytef *)out;
+            this->zs.avail_out = n;
+            while (this->zs.avail_out > 0 && !this->ended) {
+                if (this->zs.avail_in == 0) {
+                    this->zs.avail_in = this->read_raw(&this->raw[0], this->raw.size());
+                    this->zs.next_in = (Bytef *)&this->raw[0];
+                    if (this->zs.avail_in == 0) {
+                        this->fail("truncated gzip data");
+                    }
+                }
+                int ret = inflate(&this->zs, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END) {
+                    // fichiers concatenes (cat a.gz b.gz) : membre suivant s'il en reste
+                    if (this->zs.avail_in == 0) {
+                        this->zs.avail_in = this->read_raw(&this->raw[0], this->raw.size());
+                        this->zs.next_in = (Bytef *)&this->raw[0];
+                    }
+                    if (this->zs.avail_in == 0) this->ended = true;
+                    else inflateReset(&this->zs);
+                } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                    this->fail(string("bad gzip data (") + (this->zs.msg != NULL ? this->zs.msg : "inflate error") + ")");
+                }
+            }
+            return n - this->zs.avail_out;
+        }
+};
+#endif
+
+
+#ifdef HAVE_LIBZSTD
+class SfannZstdDecoder : public SfannDecoder {
+
+    private:
+        ZSTD_DStream * ds;
+        ZSTD_inBuffer in;
+        // 0 entre deux trames
+        size_t pending;
+
+    public:
+        SfannZstdDecoder(SfannInput * input) throw (SfannException) : SfannDecoder(input) {
+            this->ds = ZSTD_createDStream();
+            if (this->ds == NULL || ZSTD_isError(ZSTD_initDStream(this->ds))) {
+                if (this->ds != NULL) ZSTD_freeDStream(this->ds);
+                this->fail("impossible initialization of zstd");
+            }
+            this->in.src = &this->raw[0];
+            this->in.size = 0;
+            this->in.pos = 0;
+            this->pending = 0;
+        }
+
+        ~SfannZstdDecoder() {
+            ZSTD_freeDStream(this->ds);
+        }
+
+        size_t decode(char * out, size_t n) throw (SfannException) {
+            ZSTD_outBuffer o = {out, n, 0};
+            while (o.pos < o.size) {
+                if (this->in.pos == this->in.size) {
+                    this->in.size = this->read_raw(&this->raw[0], this->raw.size());
+                    this->in.pos = 0;
+                    if (this->in.size == 0) {
+                        if (this->pending != 0) this->fail("truncated zstd data");
+                        break;
+                    }
+                }
+                size_t ret = ZSTD_decompressStream(this->ds, &o, &this->in);
+                if (ZSTD_isError(ret)) {
+                    this->fail(string("bad zstd data (") + ZSTD_getErrorName(ret) + ")");
+                }
+                this->pending = ret;
+            }
+            return o.pos;
+        }
+};
+#endif
+
+
+string SfannInput::format_name(format kind) {
+    switch (kind) {
+        case GZIP: return "gzip";
+        case ZSTD: return "zstd";
+        default: return "plain";
+    }
+}
+
+SfannInput::SfannInput(const string & file) throw (SfannException) {
+    this->file = file;
+    this->decoder = NULL;
+    this->thread_started = false;
+    this->finished = false;
+    this->stop = false;
+    this->current = 0;
+    this->current_pos = 0;
+    this->line_pos = 0;
+    this->line_len = 0;
+    this->magic_pos = 0;
+
+    this->f = fopen(file.c_str(), "rb");
+    if (this->f == NULL) {
+        throw SfannException("Impossible read of " + file + " !");
+    }
+
+    // reconnaissance du format ; les octets lus sont rendus ensuite par read_raw
+    this->magic.resize(4);
+    this->magic.resize(fread(&this->magic[0], 1, 4, this->f));
+    const unsigned char * m = (const unsigned char *)(this->magic.empty() ? NULL : &this->magic[0]);
+    this->kind = PLAIN;
+    if (this->magic.size() >= 2 && m[0] == 0x1f && m[1] == 0x8b) this->kind = GZIP;
+    else if (this->magic.size() >= 4 && m[0] == 0x28 && m[1] == 0xb5 && m[2] == 0x2f && m[3] == 0xfd) this->kind = ZSTD;
+
+    if (this->kind == PLAIN) return;
+
+    try {
+#ifdef HAVE_LIBZ
+        if (this->kind == GZIP) this->decoder = new SfannGzipDecoder(this);
+#endif
+#ifdef HAVE_LIBZSTD
+        if (this->kind == ZSTD) this->decoder = new SfannZstdDecoder(this);
+#endif
+    } catch (SfannException & e) {
+        fclose(this->f);
+        throw;
+    } catch (exception & e) {
+        fclose(this->f);
+        throw SfannException("Impossible to decompress " + file + " : " + e.what());
+    }
+    if (this->decoder == NULL) {
+        fclose(this->f);
+        throw SfannException("File " + file + " is compressed with " + format_name(this->kind) + ", but sfann was compiled without " + format_name(this->kind) + " support !");
+    }
+
+    this->chunks.resize(num_chunks, vector<char>(chunk_size));
+    this->chunk_len.resize(num_chunks, 0);
+    this->full.resize(num_chunks, false);
+    pthread_mutex_init(&this->mutex, NULL);
+    pthread_cond_init(&this->cond, NULL);
+    if (pthread_create(&this->thread, NULL, decompress, this) != 0) {
+        pthread_mutex_destroy(&this->mutex);
+        pthread_cond_destroy(&this->cond);
+        delete this->decoder;
+        fclose(this->f);
+        throw SfannException("Impossible creation of the decompression thread for " + file + " !");
+    }
+    this->thread_started = true;
+}
+
+SfannInput::~SfannInput() {
+    this->close();
+}
+
+void SfannInput::close() {
+    if (this->thread_started) {
+        pthread_mutex_lock(&this->mutex);
+        this->stop = true;
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+        pthread_join(this->thread, NULL);
+        pthread_mutex_destroy(&this->mutex);
+        pthread_cond_destroy(&this->cond);
+        this->thread_started = false;
+    }
+    if (this->decoder != NULL) {
+        delete this->decoder;
+        this->decoder = NULL;
+    }
+    if (this->f != NULL) {
+        fclose(this->f);
+        this->f = NULL;
+    }
+}
+
+size_t SfannInput::read_raw(char * buf, size_t n) {
+    size_t done = 0;
+    while (this->magic_pos < this->magic.size() && done < n) {
+        buf[done++] = this->magic[this->magic_pos++];
+    }
+    if (done < n) done += fread(buf + done, 1, n - done, this->f);
+    return done;
+}
+
+void * SfannInput::decompress(void * input) {
+    ((SfannInput *)input)->decompress_chunks();
+    return NULL;
+}
+
+void SfannInput::decompress_chunks() {
+    try {
+        for (size_t c = 0; ; c = (c + 1) % num_chunks) {
+            pthread_mutex_lock(&this->mutex);
+            while (this->full[c] && !this->stop) pthread_cond_wait(&this->cond, &this->mutex);
+            bool stopped = this->stop;
+            pthread_mutex_unlock(&this->mutex);
+            if (stopped) return;
+
+            // le bloc libre n'est touche que par ce thread jusqu'a ce qu'il soit marque plein
+            size_t len = 0;
+            while (len < chunk_size) {
+                size_t n = this->decoder->decode(&this->chunks[c][len], chunk_size - len);
+                if (n == 0) break;
+                len += n;
+            }
+
+            pthread_mutex_lock(&this->mutex);
+            this->chunk_len[c] = len;
+            this->full[c] = len > 0;
+            if (len < chunk_size) this->finished = true;
+            pthread_cond_broadcast(&this->cond);
+            pthread_mutex_unlock(&this->mutex);
+            if (len < chunk_size) return;
+        }
+    } catch (SfannException & e) {
+        pthread_mutex_lock(&this->mutex);
+        this->error = e.what();
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+    } catch (exception & e) {
+        // bad_alloc d'un bloc... : une exception ne doit pas sortir du thread
+        pthread_mutex_lock(&this->mutex);
+        this->error = string("Error while decompressing ") + format_name(this->kind) + " data : " + e.what();
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+    }
+}
+
+size_t SfannInput::read(char * buf, size_t n) throw (SfannException) {
+    if (this->kind == PLAIN) return this->read_raw(buf, n);
+
+    size_t done = 0;
+    while (done < n) {
+        if (this->current_pos == 0) {
+            // attend le bloc courant ; les erreurs ne sont rendues qu'apres les blocs deja prets
+            pthread_mutex_lock(&this->mutex);
+            while (!this->full[this->current] && !this->finished && this->error.empty()) pthread_cond_wait(&this->cond, &this->mutex);
+            bool ready = this->full[this->current];
+            string error = this->error;
+            pthread_mutex_unlock(&this->mutex);
+            if (!ready) {
+                if (!error.empty()) throw SfannException(error);
+                break;
+            }
+        }
+
+        size_t len = this->chunk_len[this->current];
+        size_t k = min(n - done, len - this->current_pos);
+        memcpy(buf + done, &this->chunks[this->current][this->current_pos], k);
+        done += k;
+        this->current_pos += k;
+
+        if (this->current_pos == len) {
+            pthread_mutex_lock(&this->mutex);
+            this->full[this->current] = false;
+            pthread_cond_broadcast(&this->cond);
+            pthread_mutex_unlock(&this->mutex);
+            this->current = (this->current + 1) % num_chunks;
+            this->current_pos = 0;
+        }
+    }
+    return done;
+}
+
+bool SfannInput::getline(string & line) throw (SfannException) {
+    line.clear();
+    if (this->line_buffer.empty()) this->line_buffer.resize(line_buffer_size);
+    while (true) {
+        if (this->line_pos == this->line_len) {
+            this->line_len = this->read(&this->line_buffer[0], this->line_buffer.size());
+            this->line_pos = 0;
+            if (this->line_len == 0) return !line.empty();
+        }
+        const char * start = &this->line_buffer[this->line_pos];
+        const char * nl = (const char *)memchr(start, '\n', this->line_len - this->line_pos);
+        if (nl != NULL) {
+            line.append(start, nl - start);
+            this->line_pos += nl - start + 1;
+            return true;
+        }
+        line.append(start, this->line_len - this->line_pos);
+        this->line_pos = this->line_len;
+    }
+}
@@ -0,0 +1,109 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNINPUT__
+#define __LIB_SFANNINPUT__
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <pthread.h>
+#include "SfannException.hpp"
+
+using namespace std;
+
+class SfannDecoder;
+
+// Lecture d'un fichier de corpus, compresse ou non.
+//
+// Le format est reconnu aux premiers octets (gzip : 1f 8b, zstd : 28 b5 2f fd),
+// pas a l'extension. Un fichier compresse est decompresse par un thread dans
+// un anneau de blocs, pendant que l'appelant analyse les blocs deja prets ;
+// un fichier non compresse est lu directement.
+class SfannInput {
+
+    public:
+        enum format {PLAIN, GZIP, ZSTD};
+
+    friend class SfannDecoder;
+
+    private:
+        string file;
+        FILE * f;
+        format kind;
+        // premiers octets deja lus pour reconnaitre le format
+        vector<char> magic;
+        size_t magic_pos;
+
+        // anneau de blocs decompresses, partage avec le thread et protege par <mutex>
+        SfannDecoder * decoder;
+        vector< vector<char> > chunks;
+        vector<size_t> chunk_len;
+        vector<bool> full;
+        bool finished;
+        bool stop;
+        string error;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        pthread_t thread;
+        bool thread_started;
+        // bloc en cours de lecture par l'appelant et position dans ce bloc
+        size_t current;
+        size_t current_pos;
+
+        // tampon de getline
+        vector<char> line_buffer;
+        size_t line_pos;
+        size_t line_len;
+
+        // octets du fichier sur le disque (compresses), pour les decodeurs
+        size_t read_raw(char * buf, size_t n);
+
+        static void * decompress(void * input);
+        void decompress_chunks();
+        void close();
+
+    public:
+        SfannInput(const string & file) throw (SfannException);
+        ~SfannInput();
+
+        // lit au plus <n> octets (decompresses) dans <buf>, 0 a la fin du fichier
+        size_t read(char * buf, size_t n) throw (SfannException);
+        // ligne suivante sans le '\n', faux a la fin du fichier
+        bool getline(string & line) throw (SfannException);
+
+        format get_format() {return this->kind;};
+        static string format_name(format kind);
+};
+
+#endif
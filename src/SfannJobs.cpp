@@ -0,0 +1,221 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannJobs.hpp"
+#include "SfannPerf.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+
+// arrete les experiences encore en cours quand le pere abandonne, pour ne laisser ni orphelin ni zombie
+static void kill_running(map<pid_t, size_t> & running) {
+    for (map<pid_t, size_t>::iterator it = running.begin(); it != running.end(); ++it) {
+        kill(it->first, SIGTERM);
+    }
+    for (map<pid_t, size_t>::iterator it = running.begin(); it != running.end(); ++it) {
+        while (waitpid(it->first, NULL, 0) < 0 && errno == EINTR) {}
+    }
+    running.clear();
+}
+
+void SfannJobs::tokenize(const string & line, vector<string> & tokens) throw (SfannException) {
+    tokens.clear();
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) i++;
+        if (i == line.size()) break;
+        string token;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') {
+            if (line[i] == '"') {
+                size_t end = line.find('"', i + 1);
+                if (end == string::npos) {
+                    throw SfannException("unterminated quote");
+                }
+                token += line.substr(i + 1, end - i - 1);
+                i = end + 1;
+            } else {
+                token += line[i++];
+            }
+        }
+        tokens.push_back(token);
+    }
+}
+
+void SfannJobs::read(const string & file, vector<sfann_job> & jobs) throw (SfannException) {
+    ifstream f(file.c_str());
+    if (!f.is_open()) {
+        throw SfannException("Impossible read of " + file + " !");
+    }
+
+    set<string> names;
+    string line;
+    int num_line = 0;
+    while (getline(f, line)) {
+        num_line++;
+        vector<string> tokens;
+        try {
+            tokenize(line, tokens);
+        } catch (SfannException & e) {
+            ostringstream oss;
+            oss << "Error in " << file << " line " << num_line << " : " << e.what();
+            throw SfannException(oss.str());
+        }
+        if (tokens.empty() || tokens[0][0] == '#') continue;
+
+        sfann_job job;
+        job.name = tokens[0];
+        job.args.assign(tokens.begin() + 1, tokens.end());
+        job.line = num_line;
+
+        // le nom sert de nom de fichier
+        bool valid = job.name[0] != '-' && job.name[0] != '.';
+        for (size_t k=0; k<job.name.size(); k++) {
+            char c = job.name[k];
+            if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.') valid = false;
+        }
+        if (!valid || !names.insert(job.name).second) {
+            ostringstream oss;
+            oss << "Error in " << file << " line " << num_line << " : " << (valid ? "duplicate" : "bad") << " experiment name \"" << job.name << "\" (letters, digits, '-', '_' and '.' expected)";
+            throw SfannException(oss.str());
+        }
+        jobs.push_back(job);
+    }
+
+    if (jobs.empty()) {
+        throw SfannException("No experiment in " + file + " !");
+    }
+}
+
+int SfannJobs::run(const vector<sfann_job> & jobs, int parallel, const string & dir, sfann_job_runner runner) throw (SfannException) {
+    if (parallel < 1) parallel = 1;
+    vector<sfann_job_result> results(jobs.size());
+    vector<double> starts(jobs.size(), 0);
+    map<pid_t, size_t> running;
+    size_t next = 0;
+    int failed = 0;
+
+    cout << "-> Running " << jobs.size() << " experiments, " << parallel << " at a time (outputs in " << dir << ")" << endl;
+
+    try {
+        while (next < jobs.size() || !running.empty()) {
+            while (next < jobs.size() && (int)running.size() < parallel) {
+                const sfann_job & job = jobs[next];
+                string out = dir + "/" + job.name + ".out";
+                int fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0) {
+                    throw SfannException("Impossible write of " + out + " !");
+                }
+
+                // les tampons du pere ne doivent pas etre ecrits une seconde fois par le fils
+                cout.flush();
+                cerr.flush();
+                fflush(NULL);
+                pid_t pid = fork();
+                if (pid == 0) {
+                    dup2(fd, 1);
+                    dup2(fd, 2);
+                    close(fd);
+                    int status = runner(job);
+                    cout.flush();
+                    cerr.flush();
+                    fflush(NULL);
+                    _exit(status);
+                }
+                close(fd);
+                if (pid < 0) {
+                    throw SfannException("Impossible creation of the process of experiment " + job.name + " !");
+                }
+                starts[next] = SfannPerf::now();
+                running[pid] = next;
+                next++;
+            }
+
+            int status;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0) {
+                if (errno == EINTR) continue;
+                throw SfannException("Error while waiting for the experiments !");
+            }
+            map<pid_t, size_t>::iterator it = running.find(pid);
+            if (it == running.end()) continue;
+            size_t j = it->second;
+            running.erase(it);
+
+            results[j].seconds = SfannPerf::now() - starts[j];
+            results[j].status = WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status);
+            if (results[j].status == 0) {
+                printf(" ->  %s : Ok ! (%.1f s)\n", jobs[j].name.c_str(), results[j].seconds);
+            } else {
+                failed++;
+                printf(" ->  %s : failed (%s %d, see %s/%s.out)\n", jobs[j].name.c_str(), results[j].status < 0 ? "signal" : "exit code",
+                       results[j].status < 0 ? -results[j].status : results[j].status, dir.c_str(), jobs[j].name.c_str());
+            }
+            fflush(stdout);
+        }
+    } catch (SfannException & e) {
+        kill_running(running);
+        throw;
+    } catch (exception & e) {
+        kill_running(running);
+        throw SfannException(string("Error while running the experiments : ") + e.what());
+    }
+
+    string summary = dir + "/jobs.tsv";
+    FILE * f = fopen(summary.c_str(), "w");
+    if (f == NULL) {
+        throw SfannException("Impossible write of " + summary + " !");
+    }
+    fprintf(f, "name\tline\tstatus\tseconds\n");
+    for (size_t j=0; j<jobs.size(); j++) {
+        fprintf(f, "%s\t%d\t%d\t%.3f\n", jobs[j].name.c_str(), jobs[j].line, results[j].status, results[j].seconds);
+    }
+    if (fclose(f) != 0) {
+        throw SfannException("Error while writing " + summary + " !");
+    }
+
+    cout << "-> " << jobs.size() - failed << "/" << jobs.size() << " experiments succeeded (summary in " << summary << ")" << endl;
+    return failed;
+}
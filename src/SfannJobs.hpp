@@ -0,0 +1,89 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNJOBS__
+#define __LIB_SFANNJOBS__
+
+#include <string>
+#include <vector>
+#include "SfannException.hpp"
+
+using namespace std;
+
+// une experience d'un fichier de --jobs-file
+typedef struct sfann_job {
+    string name;
+    // options de la ligne, qui remplacent celles de la ligne de commande
+    vector<string> args;
+    int line;
+} sfann_job;
+
+// bilan d'une experience
+typedef struct sfann_job_result {
+    // code de sortie, < 0 si l'experience a ete tuee par un signal
+    int status;
+    double seconds;
+} sfann_job_result;
+
+// lance une experience (dans un processus fils), rend son code de sortie
+typedef int (*sfann_job_runner)(const sfann_job & job);
+
+
+// Plusieurs experiences sur des donnees chargees une fois.
+//
+// Fichier : une experience par ligne, "<nom> <options>" (lignes vides et
+// commencant par # ignorees, "..." pour une valeur avec des blancs).
+//
+// Chaque experience tourne dans un processus fils cree par fork apres le
+// chargement : les corpus sont partages (copie a l'ecriture) sans etre relus,
+// et l'etat de l'apprentissage reste propre a chaque experience. Au plus
+// <parallel> experiences tournent en meme temps. Si le pere s'arrete sur une
+// erreur, les experiences en cours sont tuees et attendues.
+//
+// Les experiences ne sont pas des taches de SfannTasks : chacune a ses options
+// (job_config), mais aussi sa sortie standard (<nom>.out), son journal
+// (SfannLog) et ses mesures (SfannPerf), qui sont propres a un processus.
+class SfannJobs {
+
+    private:
+        static void tokenize(const string & line, vector<string> & tokens) throw (SfannException);
+
+    public:
+        static void read(const string & file, vector<sfann_job> & jobs) throw (SfannException);
+
+        // lance les experiences, sorties de chacune dans <dir>/<nom>.out et bilan dans <dir>/jobs.tsv ;
+        // rend le nombre d'experiences en echec
+        static int run(const vector<sfann_job> & jobs, int parallel, const string & dir, sfann_job_runner runner) throw (SfannException);
+};
+
+#endif
@@ -0,0 +1,130 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannLog.hpp"
+#include "SfannPerf.hpp"
+
+FILE * SfannLog::file = NULL;
+char * SfannLog::buffer = NULL;
+SfannLog::log_format SfannLog::format = SfannLog::LOG_CSV;
+
+
+void SfannLog::open(const string & file, const string & format) throw (SfannException) {
+    if (format != "csv" && format != "jsonl") {
+        throw SfannException("Unknown log format : " + format + " (csv or jsonl expected)");
+    }
+    SfannLog::close();
+
+    SfannLog::file = fopen(file.c_str(), "w");
+    if (SfannLog::file == NULL) {
+        throw SfannException("Impossible write of " + file + " !");
+    }
+    SfannLog::buffer = new char[SFANN_LOG_BUFFER];
+    setvbuf(SfannLog::file, SfannLog::buffer, _IOFBF, SFANN_LOG_BUFFER);
+
+    SfannLog::format = (format == "csv") ? LOG_CSV : LOG_JSONL;
+    if (SfannLog::format == LOG_CSV) {
+        fprintf(SfannLog::file, "type,elapsed_sec,fold,run,epoch,best_on,train_mse,bit_fail,dev_mse,dev_ccr,test_mse,test_ccr,train_ex_per_sec,eval_ex_per_sec,dev_sample_ccr\n");
+    }
+}
+
+void SfannLog::close() throw (SfannException) {
+    if (SfannLog::file == NULL) return;
+    int res = fclose(SfannLog::file);
+    SfannLog::file = NULL;
+    delete[] SfannLog::buffer;
+    SfannLog::buffer = NULL;
+    if (res != 0) {
+        throw SfannException("Error while writing the training log !");
+    }
+}
+
+void SfannLog::write_value(const char * name, double v, const char * fmt) {
+    if (SfannLog::format == LOG_CSV) {
+        fputc(',', SfannLog::file);
+        if (v >= 0) fprintf(SfannLog::file, fmt, v);
+    } else {
+        fprintf(SfannLog::file, ", \"%s\": ", name);
+        if (v >= 0) fprintf(SfannLog::file, fmt, v);
+        else fputs("null", SfannLog::file);
+    }
+}
+
+void SfannLog::begin(const char * type, int fold, int run) {
+    if (SfannLog::format == LOG_CSV) {
+        fprintf(SfannLog::file, "%s,%.3f", type, SfannPerf::elapsed());
+    } else {
+        fprintf(SfannLog::file, "{\"type\": \"%s\", \"elapsed_sec\": %.3f", type, SfannPerf::elapsed());
+    }
+    write_value("fold", fold, "%.0f");
+    write_value("run", run, "%.0f");
+}
+
+void SfannLog::report(const log_report & r) {
+    if (SfannLog::file == NULL) return;
+    // une ligne a la fois, quel que soit l'apprentissage qui l'ecrit
+    flockfile(SfannLog::file);
+    begin("report", r.fold, r.run);
+    write_value("epoch", r.epoch, "%.0f");
+    if (SfannLog::format == LOG_CSV) fputc(',', SfannLog::file);
+    write_value("train_mse", r.train_mse, "%.6f");
+    write_value("bit_fail", r.bit_fail, "%.0f");
+    write_value("dev_mse", r.dev_mse, "%.6f");
+    write_value("dev_ccr", r.dev_ccr, "%.6f");
+    write_value("test_mse", r.test_mse, "%.6f");
+    write_value("test_ccr", r.test_ccr, "%.6f");
+    write_value("train_ex_per_sec", r.train_rate, "%.1f");
+    write_value("eval_ex_per_sec", r.eval_rate, "%.1f");
+    write_value("dev_sample_ccr", r.dev_sample_ccr, "%.6f");
+    fputs(SfannLog::format == LOG_CSV ? "\n" : "}\n", SfannLog::file);
+    funlockfile(SfannLog::file);
+}
+
+void SfannLog::result(const log_result & r) {
+    if (SfannLog::file == NULL) return;
+    flockfile(SfannLog::file);
+    begin("result", r.fold, r.run);
+    if (SfannLog::format == LOG_CSV) {
+        fprintf(SfannLog::file, ",,%s", r.best_on);
+    } else {
+        fprintf(SfannLog::file, ", \"best_on\": \"%s\"", r.best_on);
+    }
+    write_value("train_mse", r.train_mse, "%.6f");
+    // CSV : ni bit_fail, ni dev_mse, ni test_mse
+    if (SfannLog::format == LOG_CSV) fputs(",,", SfannLog::file);
+    write_value("dev_ccr", r.dev_ccr, "%.6f");
+    if (SfannLog::format == LOG_CSV) fputc(',', SfannLog::file);
+    write_value("test_ccr", r.test_ccr, "%.6f");
+    fputs(SfannLog::format == LOG_CSV ? ",,,\n" : "}\n", SfannLog::file);
+    funlockfile(SfannLog::file);
+}
@@ -0,0 +1,100 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNLOG__
+#define __LIB_SFANNLOG__
+
+#include <string>
+#include <cstdio>
+#include "SfannException.hpp"
+
+using namespace std;
+
+// taille du tampon d'ecriture du journal
+#define SFANN_LOG_BUFFER (1 << 20)
+
+// une ligne du tableau d'apprentissage (valeurs < 0 : non calculees)
+typedef struct log_report {
+    int fold;
+    int run;
+    unsigned int epoch;
+    float train_mse;
+    unsigned int bit_fail;
+    float dev_mse;
+    float dev_ccr;
+    // taux de classification sur l'echantillon du dev (--dev-sample), < 0 sans echantillon
+    float dev_sample_ccr;
+    float test_mse;
+    float test_ccr;
+    // exemples par seconde depuis le rapport precedent
+    double train_rate;
+    double eval_rate;
+} log_report;
+
+// meilleur reseau d'un run (fold/run < 0 pour le resultat global de la validation croisee)
+typedef struct log_result {
+    int fold;
+    int run;
+    // "train", "dev" ou "test" : corpus sur lequel le reseau est le meilleur
+    const char * best_on;
+    float train_mse;
+    float dev_ccr;
+    float test_ccr;
+} log_result;
+
+
+// Journal d'apprentissage lisible par un programme (CSV ou lignes JSON), ecrit par un grand tampon
+class SfannLog {
+
+    private:
+        typedef enum {LOG_CSV, LOG_JSONL} log_format;
+
+        static FILE * file;
+        static char * buffer;
+        static log_format format;
+
+        // ecrit <v>, ou une valeur vide (null en JSON) si <v> < 0
+        static void write_value(const char * name, double v, const char * fmt);
+        static void begin(const char * type, int fold, int run);
+
+    public:
+        // <format> : "csv" ou "jsonl"
+        static void open(const string & file, const string & format) throw (SfannException);
+        static void close() throw (SfannException);
+        static bool is_open() {return SfannLog::file != NULL;};
+
+        static void report(const log_report & r);
+        static void result(const log_result & r);
+};
+
+#endif
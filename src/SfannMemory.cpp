@@ -0,0 +1,195 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannMemory.hpp"
+
+#include <sstream>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <pthread.h>
+
+map<string, mem_category> SfannMemory::categories;
+vector<string> SfannMemory::order;
+unsigned long long SfannMemory::current_total = 0;
+unsigned long long SfannMemory::peak_total = 0;
+unsigned long long SfannMemory::limit = 0;
+
+// le compte est partage par les apprentissages concurrents
+static pthread_mutex_t memory_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+unsigned long long SfannMemory::data_size(unsigned long long num_data, unsigned int num_input, unsigned int num_output) {
+    // valeurs, et pointeurs des lignes d'entrees et de sorties
+    return num_data * ((unsigned long long)(num_input + num_output) * sizeof(fann_type) + 2 * sizeof(fann_type *));
+}
+
+void SfannMemory::set_limit(unsigned long long bytes) {
+    SfannMemory::limit = bytes;
+}
+
+unsigned long long SfannMemory::get_limit() {
+    return SfannMemory::limit;
+}
+
+string SfannMemory::to_mb(unsigned long long bytes) {
+    char buf[64];
+    sprintf(buf, "%.1f MB", bytes / (1024. * 1024.));
+    return string(buf);
+}
+
+void SfannMemory::check(const string & what, unsigned long long bytes) throw (SfannException) {
+    pthread_mutex_lock(&memory_mutex);
+    try {
+        check_locked(what, bytes);
+    } catch (SfannException & e) {
+        pthread_mutex_unlock(&memory_mutex);
+        throw;
+    }
+    pthread_mutex_unlock(&memory_mutex);
+}
+
+void SfannMemory::check_locked(const string & what, unsigned long long bytes) throw (SfannException) {
+    if (SfannMemory::limit > 0 && SfannMemory::current_total + bytes > SfannMemory::limit) {
+        ostringstream oss;
+        oss << "Memory limit exceeded : " << what << " needs " << to_mb(bytes) << " while " << to_mb(SfannMemory::current_total) << " are already used (";
+        for (size_t i = 0; i < SfannMemory::order.size(); i++) {
+            oss << SfannMemory::order[i] << " " << to_mb(SfannMemory::categories[SfannMemory::order[i]].current) << ", ";
+        }
+        oss << "RSS " << to_mb(current_rss()) << "), the limit is " << to_mb(SfannMemory::limit) << " !";
+        throw SfannException(oss.str());
+    }
+}
+
+void SfannMemory::allocate(const string & category, unsigned long long bytes) throw (SfannException) {
+    pthread_mutex_lock(&memory_mutex);
+    try {
+        check_locked(category, bytes);
+    } catch (SfannException & e) {
+        pthread_mutex_unlock(&memory_mutex);
+        throw;
+    }
+
+    map<string, mem_category>::iterator it = SfannMemory::categories.find(category);
+    if (it == SfannMemory::categories.end()) {
+        mem_category c;
+        c.current = 0;
+        c.peak = 0;
+        it = SfannMemory::categories.insert(make_pair(category, c)).first;
+        SfannMemory::order.push_back(category);
+    }
+    it->second.current += bytes;
+    if (it->second.current > it->second.peak) it->second.peak = it->second.current;
+
+    SfannMemory::current_total += bytes;
+    if (SfannMemory::current_total > SfannMemory::peak_total) SfannMemory::peak_total = SfannMemory::current_total;
+    pthread_mutex_unlock(&memory_mutex);
+}
+
+void SfannMemory::release(const string & category, unsigned long long bytes) {
+    pthread_mutex_lock(&memory_mutex);
+    map<string, mem_category>::iterator it = SfannMemory::categories.find(category);
+    if (it != SfannMemory::categories.end()) {
+        if (bytes > it->second.current) bytes = it->second.current;
+        it->second.current -= bytes;
+        SfannMemory::current_total -= bytes;
+    }
+    pthread_mutex_unlock(&memory_mutex);
+}
+
+unsigned long long SfannMemory::current() {
+    pthread_mutex_lock(&memory_mutex);
+    unsigned long long res = SfannMemory::current_total;
+    pthread_mutex_unlock(&memory_mutex);
+    return res;
+}
+
+unsigned long long SfannMemory::peak() {
+    pthread_mutex_lock(&memory_mutex);
+    unsigned long long res = SfannMemory::peak_total;
+    pthread_mutex_unlock(&memory_mutex);
+    return res;
+}
+
+unsigned long long SfannMemory::current(const string & category) {
+    pthread_mutex_lock(&memory_mutex);
+    map<string, mem_category>::iterator it = SfannMemory::categories.find(category);
+    unsigned long long res = it == SfannMemory::categories.end() ? 0 : it->second.current;
+    pthread_mutex_unlock(&memory_mutex);
+    return res;
+}
+
+unsigned long long SfannMemory::peak(const string & category) {
+    pthread_mutex_lock(&memory_mutex);
+    map<string, mem_category>::iterator it = SfannMemory::categories.find(category);
+    unsigned long long res = it == SfannMemory::categories.end() ? 0 : it->second.peak;
+    pthread_mutex_unlock(&memory_mutex);
+    return res;
+}
+
+unsigned long long SfannMemory::current_rss() {
+    // deuxieme champ de /proc/self/statm, en pages
+    FILE * f = fopen("/proc/self/statm", "r");
+    if (f == NULL) return 0;
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    if (n != 2) return 0;
+    return (unsigned long long)resident * sysconf(_SC_PAGESIZE);
+}
+
+unsigned long long SfannMemory::peak_rss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    // en kilo-octets sous Linux
+    return (unsigned long long)usage.ru_maxrss * 1024;
+}
+
+string SfannMemory::summary() {
+    ostringstream oss;
+    oss << "peak " << to_mb(SfannMemory::peak_total) << " accounted (";
+    for (size_t i = 0; i < SfannMemory::order.size(); i++) {
+        oss << (i > 0 ? ", " : "") << SfannMemory::order[i] << " " << to_mb(SfannMemory::categories[SfannMemory::order[i]].peak);
+    }
+    oss << "), peak RSS " << to_mb(peak_rss());
+    return oss.str();
+}
+
+void SfannMemory::write_json(FILE * f) {
+    fprintf(f, "{\"limit_bytes\": %llu, \"current_bytes\": %llu, \"peak_bytes\": %llu, \"rss_bytes\": %llu, \"peak_rss_bytes\": %llu, \"categories\": [",
+            SfannMemory::limit, SfannMemory::current_total, SfannMemory::peak_total, current_rss(), peak_rss());
+    for (size_t i = 0; i < SfannMemory::order.size(); i++) {
+        const mem_category & c = SfannMemory::categories[SfannMemory::order[i]];
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"current_bytes\": %llu, \"peak_bytes\": %llu}", i > 0 ? "," : "", SfannMemory::order[i].c_str(), c.current, c.peak);
+    }
+    fprintf(f, "\n  ]}");
+}
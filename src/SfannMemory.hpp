@@ -0,0 +1,102 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNMEMORY__
+#define __LIB_SFANNMEMORY__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include "fann.h"
+#include "SfannException.hpp"
+
+using namespace std;
+
+// categories de memoire
+#define SFANN_MEM_DATASETS "datasets"
+#define SFANN_MEM_FOLDS "folds"
+#define SFANN_MEM_SNAPSHOTS "snapshots"
+#define SFANN_MEM_EVAL "eval"
+
+typedef struct mem_category {
+    unsigned long long current;
+    unsigned long long peak;
+} mem_category;
+
+
+// Compte des octets occupes par les grosses structures du programme
+// (corpus, folds de la validation croisee, sauvegardes de reseaux, tampons d'evaluation)
+class SfannMemory {
+
+    private:
+        static map<string, mem_category> categories;
+        static vector<string> order;
+        static unsigned long long current_total;
+        static unsigned long long peak_total;
+        // 0 = pas de limite
+        static unsigned long long limit;
+
+        static string to_mb(unsigned long long bytes);
+        // check, le mutex du compte etant deja pris
+        static void check_locked(const string & what, unsigned long long bytes) throw (SfannException);
+
+    public:
+        static void set_limit(unsigned long long bytes);
+        static unsigned long long get_limit();
+
+        // exception si <bytes> de plus depasseraient la limite memoire, <what> est repris dans le message
+        static void check(const string & what, unsigned long long bytes) throw (SfannException);
+        // compte <bytes> dans <category>, apres verification de la limite
+        static void allocate(const string & category, unsigned long long bytes) throw (SfannException);
+        static void release(const string & category, unsigned long long bytes);
+
+        // octets de <num_data> exemples alloues par fann_create_train, a reserver avant l'allocation
+        static unsigned long long data_size(unsigned long long num_data, unsigned int num_input, unsigned int num_output);
+
+        static unsigned long long current();
+        static unsigned long long peak();
+        static unsigned long long current(const string & category);
+        static unsigned long long peak(const string & category);
+
+        // taille residente du processus, lue dans le systeme (0 si inconnue)
+        static unsigned long long current_rss();
+        static unsigned long long peak_rss();
+
+        // resume en une ligne : pic de la memoire comptee, de chaque categorie et de la taille residente
+        static string summary();
+        // objet "memory" du rapport de performances
+        static void write_json(FILE * f);
+};
+
+#endif
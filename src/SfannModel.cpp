@@ -0,0 +1,375 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+#include "SfannModel.hpp"
+
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+map<struct fann *, SfannModel::mapping> SfannModel::mapped;
+
+
+uint64_t SfannModel::align(uint64_t offset) {
+    return (offset + SFANN_MODEL_ALIGN - 1) / SFANN_MODEL_ALIGN * SFANN_MODEL_ALIGN;
+}
+
+bool SfannModel::is_binary_file(const string & file) {
+    char magic[8];
+    FILE * f = fopen(file.c_str(), "rb");
+    if (f == NULL) return false;
+    size_t n = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    return n == sizeof(magic) && memcmp(magic, SFANN_MODEL_MAGIC, sizeof(magic)) == 0;
+}
+
+void SfannModel::save_binary(struct fann * net, const string & file) throw (SfannException) {
+    if (net == NULL) {
+        throw SfannException("Trying to save a null ANN in " + file + " !");
+    }
+
+    sfann_model_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SFANN_MODEL_MAGIC, sizeof(h.magic));
+    h.version = SFANN_MODEL_VERSION;
+    h.byte_order = SFANN_MODEL_BYTE_ORDER;
+    h.fann_type_size = sizeof(fann_type);
+    h.num_layers = net->last_layer - net->first_layer;
+    h.total_neurons = net->total_neurons;
+    h.total_connections = net->total_connections;
+    h.num_input = net->num_input;
+    h.num_output = net->num_output;
+    h.network_type = net->network_type;
+#ifndef FIXEDFANN
+    h.has_scale = (net->scale_mean_in != NULL);
+#endif
+
+    h.connection_rate = net->connection_rate;
+    h.learning_rate = net->learning_rate;
+    h.learning_momentum = net->learning_momentum;
+    h.training_algorithm = net->training_algorithm;
+    h.train_error_function = net->train_error_function;
+    h.train_stop_function = net->train_stop_function;
+    h.bit_fail_limit = net->bit_fail_limit;
+    h.quickprop_decay = net->quickprop_decay;
+    h.quickprop_mu = net->quickprop_mu;
+    h.rprop_increase_factor = net->rprop_increase_factor;
+    h.rprop_decrease_factor = net->rprop_decrease_factor;
+    h.rprop_delta_min = net->rprop_delta_min;
+    h.rprop_delta_max = net->rprop_delta_max;
+    h.rprop_delta_zero = net->rprop_delta_zero;
+
+    h.layers_offset = align(sizeof(h));
+    h.neurons_offset = align(h.layers_offset + h.num_layers * sizeof(uint32_t));
+    h.connections_offset = align(h.neurons_offset + h.total_neurons * sizeof(sfann_model_neuron));
+    h.weights_offset = align(h.connections_offset + h.total_connections * sizeof(uint32_t));
+    h.scale_offset = align(h.weights_offset + h.total_connections * sizeof(fann_type));
+    h.file_size = h.scale_offset + (h.has_scale ? 4 * (h.num_input + h.num_output) * sizeof(float) : 0);
+
+    // le fichier entier est construit en memoire, puis ecrit d'un coup
+    char * buf = new char[h.file_size];
+    memset(buf, 0, h.file_size);
+    memcpy(buf, &h, sizeof(h));
+
+    uint32_t * layers = (uint32_t *)(buf + h.layers_offset);
+    for (unsigned int l = 0; l < h.num_layers; l++) {
+        layers[l] = net->first_layer[l].last_neuron - net->first_layer[l].first_neuron;
+    }
+
+    struct fann_neuron * first_neuron = net->first_layer->first_neuron;
+    sfann_model_neuron * neurons = (sfann_model_neuron *)(buf + h.neurons_offset);
+    for (unsigned int i = 0; i < h.total_neurons; i++) {
+        neurons[i].first_con = first_neuron[i].first_con;
+        neurons[i].last_con = first_neuron[i].last_con;
+        neurons[i].activation_function = first_neuron[i].activation_function;
+        neurons[i].activation_steepness = first_neuron[i].activation_steepness;
+    }
+
+    uint32_t * connections = (uint32_t *)(buf + h.connections_offset);
+    fann_type * weights = (fann_type *)(buf + h.weights_offset);
+    for (unsigned int i = 0; i < h.total_connections; i++) {
+        connections[i] = net->connections[i] - first_neuron;
+        weights[i] = net->weights[i];
+    }
+
+#ifndef FIXEDFANN
+    if (h.has_scale) {
+        float * scale = (float *)(buf + h.scale_offset);
+        memcpy(scale, net->scale_mean_in, h.num_input * sizeof(float)); scale += h.num_input;
+        memcpy(scale, net->scale_deviation_in, h.num_input * sizeof(float)); scale += h.num_input;
+        memcpy(scale, net->scale_new_min_in, h.num_input * sizeof(float)); scale += h.num_input;
+        memcpy(scale, net->scale_factor_in, h.num_input * sizeof(float)); scale += h.num_input;
+        memcpy(scale, net->scale_mean_out, h.num_output * sizeof(float)); scale += h.num_output;
+        memcpy(scale, net->scale_deviation_out, h.num_output * sizeof(float)); scale += h.num_output;
+        memcpy(scale, net->scale_new_min_out, h.num_output * sizeof(float)); scale += h.num_output;
+        memcpy(scale, net->scale_factor_out, h.num_output * sizeof(float));
+    }
+#endif
+
+    FILE * f = fopen(file.c_str(), "wb");
+    if (f == NULL) {
+        delete[] buf;
+        throw SfannException("Impossible write of " + file + " !");
+    }
+    size_t written = fwrite(buf, 1, h.file_size, f);
+    delete[] buf;
+    if (fclose(f) != 0 || written != h.file_size) {
+        throw SfannException("Error while writing " + file + " !");
+    }
+}
+
+void SfannModel::check_header(const sfann_model_header * h, size_t file_size, const string & file) throw (SfannException) {
+    ostringstream oss;
+    if (file_size < sizeof(sfann_model_header) || memcmp(h->magic, SFANN_MODEL_MAGIC, sizeof(h->magic)) != 0) {
+        oss << file << " is not a binary ANN file !";
+    } else if (h->version != SFANN_MODEL_VERSION) {
+        oss << file << " has an unsupported binary ANN version (" << h->version << ") !";
+    } else if (h->byte_order != SFANN_MODEL_BYTE_ORDER || h->fann_type_size != sizeof(fann_type)) {
+        oss << file << " was saved on an incompatible architecture (byte order or fann_type size) !";
+    } else if (h->file_size != file_size || h->num_layers < 2
+            || h->layers_offset + h->num_layers * sizeof(uint32_t) > file_size
+            || h->neurons_offset + (uint64_t)h->total_neurons * sizeof(sfann_model_neuron) > file_size
+            || h->connections_offset + (uint64_t)h->total_connections * sizeof(uint32_t) > file_size
+            || h->weights_offset + (uint64_t)h->total_connections * sizeof(fann_type) > file_size
+            || h->weights_offset % SFANN_MODEL_ALIGN != 0
+            || (h->has_scale && h->scale_offset + (uint64_t)4 * (h->num_input + h->num_output) * sizeof(float) > file_size)) {
+        oss << file << " is truncated or corrupted !";
+    } else {
+        return;
+    }
+    throw SfannException(oss.str());
+}
+
+void SfannModel::check_sections(const sfann_model_header * h, const char * buf, const string & file) throw (SfannException) {
+    bool ok = true;
+
+    const uint32_t * layers = (const uint32_t *)(buf + h->layers_offset);
+    uint64_t total_neurons = 0;
+    for (unsigned int l = 0; l < h->num_layers; l++) {
+        if (layers[l] == 0) ok = false;
+        total_neurons += layers[l];
+    }
+    // couche d'entree : entrees et biais, couche de sortie : au moins les sorties
+    if (total_neurons != h->total_neurons || layers[0] < h->num_input + 1 || layers[h->num_layers - 1] < h->num_output) ok = false;
+
+    const sfann_model_neuron * neurons = (const sfann_model_neuron *)(buf + h->neurons_offset);
+    for (unsigned int i = 0; ok && i < h->total_neurons; i++) {
+        if (neurons[i].first_con > neurons[i].last_con || neurons[i].last_con > h->total_connections) ok = false;
+    }
+
+    const uint32_t * connections = (const uint32_t *)(buf + h->connections_offset);
+    for (unsigned int i = 0; ok && i < h->total_connections; i++) {
+        if (connections[i] >= h->total_neurons) ok = false;
+    }
+
+    if (!ok) {
+        throw SfannException(file + " is truncated or corrupted !");
+    }
+}
+
+struct fann * SfannModel::load_binary(const string & file, bool shared) throw (SfannException) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw SfannException("Impossible read of " + file + " !");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        throw SfannException("Impossible read of " + file + " !");
+    }
+    size_t length = st.st_size;
+    void * addr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw SfannException("Impossible mapping of " + file + " !");
+    }
+
+    const char * buf = (const char *)addr;
+    const sfann_model_header * h = (const sfann_model_header *)buf;
+    try {
+        check_header(h, length, file);
+        check_sections(h, buf, file);
+    } catch (SfannException & e) {
+        munmap(addr, length);
+        throw;
+    }
+
+    struct fann * net = fann_allocate_structure(h->num_layers);
+    if (net == NULL) {
+        munmap(addr, length);
+        throw SfannException("Impossible allocation of the ANN of " + file + " !");
+    }
+
+    net->network_type = (enum fann_nettype_enum)h->network_type;
+    net->connection_rate = h->connection_rate;
+    net->learning_rate = h->learning_rate;
+    net->learning_momentum = h->learning_momentum;
+    net->training_algorithm = (enum fann_train_enum)h->training_algorithm;
+    net->train_error_function = (enum fann_errorfunc_enum)h->train_error_function;
+    net->train_stop_function = (enum fann_stopfunc_enum)h->train_stop_function;
+    net->bit_fail_limit = h->bit_fail_limit;
+    net->quickprop_decay = h->quickprop_decay;
+    net->quickprop_mu = h->quickprop_mu;
+    net->rprop_increase_factor = h->rprop_increase_factor;
+    net->rprop_decrease_factor = h->rprop_decrease_factor;
+    net->rprop_delta_min = h->rprop_delta_min;
+    net->rprop_delta_max = h->rprop_delta_max;
+    net->rprop_delta_zero = h->rprop_delta_zero;
+
+    // tailles des couches, pour fann_allocate_neurons (comme fann_copy)
+    const uint32_t * layers = (const uint32_t *)(buf + h->layers_offset);
+    struct fann_layer * layer_it = net->first_layer;
+    for (unsigned int l = 0; l < h->num_layers; l++, layer_it++) {
+        layer_it->first_neuron = NULL;
+        layer_it->last_neuron = layer_it->first_neuron + layers[l];
+        net->total_neurons += layers[l];
+    }
+    net->num_input = h->num_input;
+    net->num_output = h->num_output;
+
+    if (net->total_neurons != h->total_neurons) {
+        fann_destroy(net);
+        munmap(addr, length);
+        throw SfannException(file + " is truncated or corrupted !");
+    }
+
+    fann_allocate_neurons(net);
+    if (net->errno_f == FANN_E_CANT_ALLOCATE_MEM) {
+        fann_destroy(net);
+        munmap(addr, length);
+        throw SfannException("Impossible allocation of the ANN of " + file + " !");
+    }
+
+    struct fann_neuron * first_neuron = net->first_layer->first_neuron;
+    const sfann_model_neuron * neurons = (const sfann_model_neuron *)(buf + h->neurons_offset);
+    for (unsigned int i = 0; i < h->total_neurons; i++) {
+        first_neuron[i].first_con = neurons[i].first_con;
+        first_neuron[i].last_con = neurons[i].last_con;
+        first_neuron[i].activation_function = (enum fann_activationfunc_enum)neurons[i].activation_function;
+        first_neuron[i].activation_steepness = neurons[i].activation_steepness;
+    }
+
+    net->total_connections = h->total_connections;
+    fann_allocate_connections(net);
+    if (net->errno_f == FANN_E_CANT_ALLOCATE_MEM) {
+        fann_destroy(net);
+        munmap(addr, length);
+        throw SfannException("Impossible allocation of the ANN of " + file + " !");
+    }
+
+    const uint32_t * connections = (const uint32_t *)(buf + h->connections_offset);
+    for (unsigned int i = 0; i < h->total_connections; i++) {
+        net->connections[i] = first_neuron + connections[i];
+    }
+
+#ifndef FIXEDFANN
+    if (h->has_scale) {
+        fann_allocate_scale(net);
+        const float * scale = (const float *)(buf + h->scale_offset);
+        memcpy(net->scale_mean_in, scale, h->num_input * sizeof(float)); scale += h->num_input;
+        memcpy(net->scale_deviation_in, scale, h->num_input * sizeof(float)); scale += h->num_input;
+        memcpy(net->scale_new_min_in, scale, h->num_input * sizeof(float)); scale += h->num_input;
+        memcpy(net->scale_factor_in, scale, h->num_input * sizeof(float)); scale += h->num_input;
+        memcpy(net->scale_mean_out, scale, h->num_output * sizeof(float)); scale += h->num_output;
+        memcpy(net->scale_deviation_out, scale, h->num_output * sizeof(float)); scale += h->num_output;
+        memcpy(net->scale_new_min_out, scale, h->num_output * sizeof(float)); scale += h->num_output;
+        memcpy(net->scale_factor_out, scale, h->num_output * sizeof(float));
+    }
+#endif
+
+    const fann_type * weights = (const fann_type *)(buf + h->weights_offset);
+    if (shared) {
+        // les poids sont utilises en place, les pages sont partagees entre processus
+        free(net->weights);
+        net->weights = (fann_type *)weights;
+        mapping m;
+        m.addr = addr;
+        m.length = length;
+        SfannModel::mapped[net] = m;
+    } else {
+        memcpy(net->weights, weights, h->total_connections * sizeof(fann_type));
+        munmap(addr, length);
+    }
+
+    return net;
+}
+
+struct fann * SfannModel::load(const string & file, bool shared) throw (SfannException) {
+    if (SfannModel::is_binary_file(file)) {
+        return SfannModel::load_binary(file, shared);
+    }
+    struct fann * net = fann_create_from_file(file.c_str());
+    if (net == NULL) {
+        throw SfannException("Impossible read of the ANN " + file + " !");
+    }
+    return net;
+}
+
+void SfannModel::save(struct fann * net, const string & file, bool binary) throw (SfannException) {
+    if (binary) {
+        SfannModel::save_binary(net, file);
+    } else if (fann_save(net, file.c_str()) != 0) {
+        throw SfannException("Impossible write of " + file + " !");
+    }
+}
+
+void SfannModel::convert(const string & src, const string & dest, bool binary) throw (SfannException) {
+    struct fann * net = SfannModel::load(src, true);
+    try {
+        SfannModel::save(net, dest, binary);
+    } catch (SfannException & e) {
+        SfannModel::destroy(net);
+        throw;
+    }
+    SfannModel::destroy(net);
+}
+
+void SfannModel::destroy(struct fann * & net) {
+    if (net == NULL) return;
+
+    map<struct fann *, mapping>::iterator it = SfannModel::mapped.find(net);
+    if (it != SfannModel::mapped.end()) {
+        // les poids appartiennent a la projection, pas a FANN
+        net->weights = NULL;
+        fann_destroy(net);
+        munmap(it->second.addr, it->second.length);
+        SfannModel::mapped.erase(it);
+    } else {
+        fann_destroy(net);
+    }
+    net = NULL;
+}
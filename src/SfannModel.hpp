@@ -0,0 +1,140 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+#ifndef __LIB_SFANNMODEL__
+#define __LIB_SFANNMODEL__
+
+#include <string>
+#include <map>
+#include <stdint.h>
+#include "fann.h"
+#include "SfannException.hpp"
+
+using namespace std;
+
+// Format binaire des fichiers de reseaux.
+//
+// Le fichier commence par un en-tete de taille fixe, suivi de sections
+// alignees chacune sur SFANN_MODEL_ALIGN octets :
+//   - tailles des couches : uint32_t[num_layers] (neurone de biais compris)
+//   - neurones            : sfann_model_neuron[total_neurons]
+//   - connexions          : uint32_t[total_connections] (indice du neurone source)
+//   - poids               : fann_type[total_connections]
+//   - mise a l'echelle    : float[8][num_input ou num_output] (seulement si has_scale)
+// La section des poids est utilisee en place quand le fichier est projete en
+// memoire : un reseau charge par load_binary(file, true) partage ses poids
+// avec tous les processus qui projettent le meme fichier.
+
+#define SFANN_MODEL_MAGIC "SFANNBIN"
+#define SFANN_MODEL_VERSION 1
+#define SFANN_MODEL_BYTE_ORDER 0x01020304
+#define SFANN_MODEL_ALIGN 64
+
+typedef struct sfann_model_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t fann_type_size;
+    uint32_t num_layers;
+    uint32_t total_neurons;
+    uint32_t total_connections;
+    uint32_t num_input;
+    uint32_t num_output;
+    uint32_t network_type;
+    uint32_t has_scale;
+
+    float connection_rate;
+    float learning_rate;
+    float learning_momentum;
+    uint32_t training_algorithm;
+    uint32_t train_error_function;
+    uint32_t train_stop_function;
+    float bit_fail_limit;
+    float quickprop_decay;
+    float quickprop_mu;
+    float rprop_increase_factor;
+    float rprop_decrease_factor;
+    float rprop_delta_min;
+    float rprop_delta_max;
+    float rprop_delta_zero;
+
+    uint64_t layers_offset;
+    uint64_t neurons_offset;
+    uint64_t connections_offset;
+    uint64_t weights_offset;
+    uint64_t scale_offset;
+    uint64_t file_size;
+} sfann_model_header;
+
+typedef struct sfann_model_neuron {
+    uint32_t first_con;
+    uint32_t last_con;
+    uint32_t activation_function;
+    float activation_steepness;
+} sfann_model_neuron;
+
+
+class SfannModel {
+
+    private:
+        typedef struct mapping {
+            void * addr;
+            size_t length;
+        } mapping;
+
+        // reseaux dont les poids sont dans une projection du fichier en lecture seule
+        static map<struct fann *, mapping> mapped;
+
+        static uint64_t align(uint64_t offset);
+        static void check_header(const sfann_model_header * h, size_t file_size, const string & file) throw (SfannException);
+        // tailles des couches, connexions de chaque neurone et sources des connexions, avant que FANN ne s'en serve
+        static void check_sections(const sfann_model_header * h, const char * buf, const string & file) throw (SfannException);
+
+    public:
+        // vrai si <file> commence par la signature du format binaire
+        static bool is_binary_file(const string & file);
+
+        static void save_binary(struct fann * net, const string & file) throw (SfannException);
+        // si <shared>, les poids ne sont pas copies : ils pointent dans une projection
+        // de <file> en lecture seule (pour evaluer seulement, pas pour apprendre)
+        static struct fann * load_binary(const string & file, bool shared) throw (SfannException);
+
+        // charge un reseau FANN texte ou binaire, le format est reconnu au contenu du fichier
+        static struct fann * load(const string & file, bool shared) throw (SfannException);
+        static void save(struct fann * net, const string & file, bool binary) throw (SfannException);
+        static void convert(const string & src, const string & dest, bool binary) throw (SfannException);
+
+        // libere un reseau cree par cette classe (ou par FANN)
+        static void destroy(struct fann * & net);
+};
+
+#endif
@@ -0,0 +1,301 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannParse.hpp"
+#include "SfannMemory.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <locale>
+
+
+// puissances de 10 exactes en double
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// taille du tampon de SfannNumberReader, et place reservee au nombre en cours de lecture
+static const size_t reader_buffer_size = 1 << 20;
+static const size_t max_token_size = 256;
+
+static inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// <d> est-il exactement au milieu de <f> et du float voisin du cote de <d> ?
+static bool is_float_midpoint(double d, float f) {
+    if ((double)f == d) return false;
+    float g = nextafterf(f, d > (double)f ? HUGE_VALF : -HUGE_VALF);
+    return ((double)f + (double)g) / 2 == d;
+}
+
+
+bool SfannParse::parse_float(const char * & p, const char * end, fann_type & value) {
+    const char * s = p;
+    while (s < end && is_blank(*s)) s++;
+    const char * start = s;
+
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = (*s == '-');
+        s++;
+    }
+
+    // au plus 19 chiffres significatifs dans <mantissa>, valeur = mantissa * 10^exponent
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    bool truncated = false;
+    while (s < end && *s >= '0' && *s <= '9') {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*s - '0');
+            if (mantissa != 0) digits++;
+        } else {
+            exponent++;
+            if (*s != '0') truncated = true;
+        }
+        any_digit = true;
+        s++;
+    }
+    if (s < end && *s == '.') {
+        s++;
+        while (s < end && *s >= '0' && *s <= '9') {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*s - '0');
+                if (mantissa != 0) digits++;
+                exponent--;
+            } else if (*s != '0') {
+                truncated = true;
+            }
+            any_digit = true;
+            s++;
+        }
+    }
+
+    if (any_digit) {
+        if (s < end && (*s == 'e' || *s == 'E')) {
+            const char * e = s + 1;
+            bool exponent_negative = false;
+            if (e < end && (*e == '-' || *e == '+')) {
+                exponent_negative = (*e == '-');
+                e++;
+            }
+            if (e < end && *e >= '0' && *e <= '9') {
+                int value_exponent = 0;
+                while (e < end && *e >= '0' && *e <= '9') {
+                    if (value_exponent < 100000) value_exponent = value_exponent * 10 + (*e - '0');
+                    e++;
+                }
+                exponent += exponent_negative ? -value_exponent : value_exponent;
+                s = e;
+            }
+        }
+
+        if (mantissa == 0 && !truncated) {
+            value = negative ? -0.f : 0.f;
+            p = s;
+            return true;
+        }
+
+        // mantisse et puissance de 10 exactes : une seule operation, donc un double correctement arrondi,
+        // dont l'arrondi en float est correct sauf s'il tombe pile entre deux floats
+        if (!truncated && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+            double d = (double)mantissa;
+            if (exponent < 0) d /= powers_of_ten[-exponent];
+            else d *= powers_of_ten[exponent];
+            float f = (float)d;
+            if (!is_float_midpoint(d, f)) {
+                value = negative ? -f : f;
+                p = s;
+                return true;
+            }
+        }
+    }
+
+    // cas rares (plus de 19 chiffres, grands exposants, inf, nan...) : conversion de la bibliotheque standard, en locale "C"
+    const char * token_end = start;
+    while (token_end < end && !is_blank(*token_end)) token_end++;
+    string token(start, token_end);
+    if (token.empty()) return false;
+
+    istringstream iss(token);
+    iss.imbue(locale::classic());
+    float v;
+    if (iss >> v) {
+        value = v;
+        p = iss.eof() ? token_end : start + (size_t)iss.tellg();
+        return true;
+    }
+    char * converted_end;
+    v = strtof(token.c_str(), &converted_end);
+    if (converted_end == token.c_str()) return false;
+    value = v;
+    p = start + (converted_end - token.c_str());
+    return true;
+}
+
+bool SfannParse::parse_uint(const char * & p, const char * end, unsigned int & value) {
+    const char * s = p;
+    while (s < end && is_blank(*s)) s++;
+    if (s < end && *s == '+') s++;
+    if (s >= end || *s < '0' || *s > '9') return false;
+    unsigned long long v = 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = v * 10 + (*s - '0');
+        if (v > 0xFFFFFFFFULL) return false;
+        s++;
+    }
+    value = (unsigned int)v;
+    p = s;
+    return true;
+}
+
+struct fann_train_data * SfannParse::read_fann_file(const string & file) throw (SfannException) {
+    SfannNumberReader reader(file);
+
+    unsigned int num_data, num_input, num_output;
+    read_fann_header(reader, file, num_data, num_input, num_output);
+
+    // place reservee d'apres l'en-tete, avant l'allocation
+    unsigned long long bytes = SfannMemory::data_size(num_data, num_input, num_output);
+    SfannMemory::allocate(SFANN_MEM_DATASETS, bytes);
+    struct fann_train_data * data = fann_create_train(num_data, num_input, num_output);
+    if (data == NULL) {
+        SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+        throw SfannException("Impossible allocation of the examples of " + file + " !");
+    }
+
+    try {
+        read_fann_examples(reader, file, data, 0, num_data);
+    } catch (SfannException & e) {
+        fann_destroy_train(data);
+        SfannMemory::release(SFANN_MEM_DATASETS, bytes);
+        throw;
+    }
+
+    return data;
+}
+
+void SfannParse::read_fann_header(SfannNumberReader & reader, const string & file, unsigned int & num_data, unsigned int & num_input, unsigned int & num_output) throw (SfannException) {
+    if (!reader.next(num_data) || !reader.next(num_input) || !reader.next(num_output)) {
+        throw SfannException("Error in " + file + " : header <num_data> <num_input> <num_output> expected");
+    }
+}
+
+void SfannParse::read_fann_examples(SfannNumberReader & reader, const string & file, struct fann_train_data * data, unsigned int first, unsigned int count) throw (SfannException) {
+    for (unsigned int i=0; i<count; i++) {
+        bool ok = true;
+        fann_type * in = data->input[i];
+        for (unsigned int c=0; c<data->num_input && ok; c++) ok = reader.next(in[c]);
+        fann_type * out = data->output[i];
+        for (unsigned int c=0; c<data->num_output && ok; c++) ok = reader.next(out[c]);
+        if (!ok) {
+            ostringstream oss;
+            oss << "Error in " << file << " : file ended after " << first + i << " complete examples";
+            throw SfannException(oss.str());
+        }
+    }
+}
+
+
+// SfannNumberReader
+
+SfannNumberReader::SfannNumberReader(const string & file) throw (SfannException) : input(file) {
+    this->file = file;
+    this->buffer.resize(reader_buffer_size);
+    this->pos = 0;
+    this->len = 0;
+    this->eof = false;
+    this->bytes = 0;
+}
+
+SfannNumberReader::~SfannNumberReader() {
+}
+
+void SfannNumberReader::refill() {
+    if (this->eof) return;
+    if (this->pos > 0) {
+        memmove(&this->buffer[0], &this->buffer[this->pos], this->len - this->pos);
+        this->len -= this->pos;
+        this->pos = 0;
+    }
+    size_t n = this->input.read(&this->buffer[this->len], this->buffer.size() - this->len);
+    this->len += n;
+    this->bytes += n;
+    if (n == 0) this->eof = true;
+}
+
+bool SfannNumberReader::skip_blanks() {
+    while (true) {
+        while (this->pos < this->len && is_blank(this->buffer[this->pos])) this->pos++;
+        if (this->pos < this->len) break;
+        if (this->eof) return false;
+        this->refill();
+    }
+    if (this->len - this->pos < max_token_size) this->refill();
+    return true;
+}
+
+void SfannNumberReader::check_end_of_token() throw (SfannException) {
+    if (this->pos < this->len && !is_blank(this->buffer[this->pos])) {
+        size_t end = this->pos;
+        while (end < this->len && !is_blank(this->buffer[end]) && end - this->pos < 32) end++;
+        throw SfannException("Error in " + this->file + " : bad number before \"" + string(&this->buffer[this->pos], end - this->pos) + "\"");
+    }
+}
+
+bool SfannNumberReader::next(fann_type & value) throw (SfannException) {
+    if (!this->skip_blanks()) return false;
+    const char * p = &this->buffer[this->pos];
+    if (!SfannParse::parse_float(p, &this->buffer[0] + this->len, value)) {
+        this->check_end_of_token();
+    }
+    this->pos = p - &this->buffer[0];
+    this->check_end_of_token();
+    return true;
+}
+
+bool SfannNumberReader::next(unsigned int & value) throw (SfannException) {
+    if (!this->skip_blanks()) return false;
+    const char * p = &this->buffer[this->pos];
+    if (!SfannParse::parse_uint(p, &this->buffer[0] + this->len, value)) {
+        this->check_end_of_token();
+    }
+    this->pos = p - &this->buffer[0];
+    this->check_end_of_token();
+    return true;
+}
@@ -0,0 +1,97 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNPARSE__
+#define __LIB_SFANNPARSE__
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "fann.h"
+#include "SfannException.hpp"
+#include "SfannInput.hpp"
+
+using namespace std;
+
+class SfannNumberReader;
+
+// Lecture des nombres des corpus, independante de la locale (le separateur
+// decimal est toujours '.') et sans passer par scanf
+class SfannParse {
+
+    public:
+        // lit un nombre a partir de <p> (blancs initiaux ignores) sans depasser <end>, et avance <p> apres lui ;
+        // arrondi correct a la valeur fann_type la plus proche ; faux si le texte n'est pas un nombre
+        static bool parse_float(const char * & p, const char * end, fann_type & value);
+        // meme chose pour un entier positif (en-tete des fichiers FANN)
+        static bool parse_uint(const char * & p, const char * end, unsigned int & value);
+
+        // lit un fichier au format FANN dans un seul bloc memoire (comme fann_create_train, a liberer par fann_destroy_train) ;
+        // sa place est comptee dans SFANN_MEM_DATASETS avant l'allocation (--memory-limit)
+        static struct fann_train_data * read_fann_file(const string & file) throw (SfannException);
+        // morceaux de read_fann_file : l'en-tete, puis <count> exemples ranges au debut de <data>
+        // (<first> : rang dans le fichier du premier d'entre eux, pour les messages)
+        static void read_fann_header(SfannNumberReader & reader, const string & file, unsigned int & num_data, unsigned int & num_input, unsigned int & num_output) throw (SfannException);
+        static void read_fann_examples(SfannNumberReader & reader, const string & file, struct fann_train_data * data, unsigned int first, unsigned int count) throw (SfannException);
+};
+
+
+// Lecture par blocs d'un fichier de nombres separes par des blancs (eventuellement compresse)
+class SfannNumberReader {
+
+    private:
+        SfannInput input;
+        string file;
+        vector<char> buffer;
+        size_t pos;
+        size_t len;
+        bool eof;
+        unsigned long long bytes;
+
+        // complete le tampon, pour qu'il contienne au moins un nombre entier
+        void refill();
+        // passe les blancs, faux a la fin du fichier
+        bool skip_blanks();
+        void check_end_of_token() throw (SfannException);
+
+    public:
+        SfannNumberReader(const string & file) throw (SfannException);
+        ~SfannNumberReader();
+
+        // lit le nombre suivant, faux a la fin du fichier ; exception si le texte n'est pas un nombre
+        bool next(fann_type & value) throw (SfannException);
+        bool next(unsigned int & value) throw (SfannException);
+        unsigned long long bytes_read() {return this->bytes;};
+};
+
+#endif
@@ -0,0 +1,161 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+#include "SfannPerf.hpp"
+#include "SfannMemory.hpp"
+
+#include <cstdio>
+#include <time.h>
+#include <pthread.h>
+
+map<string, perf_phase> SfannPerf::phases;
+vector<string> SfannPerf::order;
+double SfannPerf::start_time = SfannPerf::now();
+
+// phases enregistrees par les apprentissages concurrents
+static pthread_mutex_t perf_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+double SfannPerf::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double SfannPerf::elapsed() {
+    return SfannPerf::now() - SfannPerf::start_time;
+}
+
+void SfannPerf::record(const string & phase, double seconds, unsigned long long items, unsigned long long bytes_read, unsigned long long bytes_allocated) {
+    unsigned long long memory = SfannMemory::current();
+    unsigned long long rss = SfannMemory::peak_rss();
+    pthread_mutex_lock(&perf_mutex);
+    map<string, perf_phase>::iterator it = SfannPerf::phases.find(phase);
+    if (it == SfannPerf::phases.end()) {
+        perf_phase p;
+        p.count = 0;
+        p.total_time = 0;
+        p.min_time = seconds;
+        p.max_time = seconds;
+        p.items = 0;
+        p.bytes_read = 0;
+        p.bytes_allocated = 0;
+        p.memory = 0;
+        p.peak_rss = 0;
+        it = SfannPerf::phases.insert(make_pair(phase, p)).first;
+        SfannPerf::order.push_back(phase);
+    }
+    perf_phase & p = it->second;
+    p.count++;
+    p.total_time += seconds;
+    if (seconds < p.min_time) p.min_time = seconds;
+    if (seconds > p.max_time) p.max_time = seconds;
+    p.items += items;
+    p.bytes_read += bytes_read;
+    p.bytes_allocated += bytes_allocated;
+    if (memory > p.memory) p.memory = memory;
+    p.peak_rss = rss;
+    pthread_mutex_unlock(&perf_mutex);
+}
+
+const perf_phase * SfannPerf::get(const string & phase) {
+    map<string, perf_phase>::iterator it = SfannPerf::phases.find(phase);
+    return it == SfannPerf::phases.end() ? NULL : &it->second;
+}
+
+const vector<string> & SfannPerf::get_phases() {
+    return SfannPerf::order;
+}
+
+void SfannPerf::reset() {
+    SfannPerf::phases.clear();
+    SfannPerf::order.clear();
+    SfannPerf::start_time = SfannPerf::now();
+}
+
+string SfannPerf::json_escape(const string & s) {
+    string res;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '"' || s[i] == '\\') res += '\\';
+        res += s[i];
+    }
+    return res;
+}
+
+void SfannPerf::write_json(const string & file) throw (SfannException) {
+    FILE * f = fopen(file.c_str(), "w");
+    if (f == NULL) {
+        throw SfannException("Impossible write of " + file + " !");
+    }
+
+    fprintf(f, "{\n  \"total_sec\": %.6f,\n  \"phases\": [", SfannPerf::elapsed());
+    for (size_t i = 0; i < SfannPerf::order.size(); i++) {
+        const perf_phase & p = SfannPerf::phases[SfannPerf::order[i]];
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"count\": %lu, \"total_sec\": %.6f, \"avg_sec\": %.6f, \"min_sec\": %.6f, \"max_sec\": %.6f",
+                i > 0 ? "," : "", json_escape(SfannPerf::order[i]).c_str(), p.count, p.total_time, p.total_time / p.count, p.min_time, p.max_time);
+        fprintf(f, ", \"items\": %llu, \"items_per_sec\": %.1f, \"bytes_read\": %llu, \"mb_per_sec\": %.3f, \"bytes_allocated\": %llu",
+                p.items, p.total_time > 0 ? p.items / p.total_time : 0.,
+                p.bytes_read, p.total_time > 0 ? p.bytes_read / p.total_time / (1024. * 1024.) : 0.,
+                p.bytes_allocated);
+        fprintf(f, ", \"memory_bytes\": %llu, \"peak_rss_bytes\": %llu}", p.memory, p.peak_rss);
+    }
+    fprintf(f, "\n  ],\n  \"memory\": ");
+    SfannMemory::write_json(f);
+    fprintf(f, "\n}\n");
+
+    if (fclose(f) != 0) {
+        throw SfannException("Error while writing " + file + " !");
+    }
+}
+
+
+// SfannPerfScope
+
+SfannPerfScope::SfannPerfScope(const string & phase) {
+    this->phase = phase;
+    this->items = 0;
+    this->bytes_read = 0;
+    this->bytes_allocated = 0;
+    this->stopped = false;
+    this->start = SfannPerf::now();
+}
+
+SfannPerfScope::~SfannPerfScope() {
+    this->stop();
+}
+
+void SfannPerfScope::stop() {
+    if (!this->stopped) {
+        SfannPerf::record(this->phase, SfannPerf::now() - this->start, this->items, this->bytes_read, this->bytes_allocated);
+        this->stopped = true;
+    }
+}
@@ -0,0 +1,110 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+#ifndef __LIB_SFANNPERF__
+#define __LIB_SFANNPERF__
+
+#include <string>
+#include <vector>
+#include <map>
+#include "SfannException.hpp"
+
+using namespace std;
+
+// mesures cumulees d'une phase (analyse, chargement, epoque d'apprentissage...)
+typedef struct perf_phase {
+    unsigned long count;
+    double total_time;
+    double min_time;
+    double max_time;
+    // nombre d'exemples traites
+    unsigned long long items;
+    // nombre d'octets lus sur le disque
+    unsigned long long bytes_read;
+    // nombre d'octets alloues pour les donnees et reseaux construits par la phase
+    unsigned long long bytes_allocated;
+    // plus grande memoire comptee par SfannMemory a la fin de la phase
+    unsigned long long memory;
+    // pic de la taille residente du processus a la fin de la phase
+    unsigned long long peak_rss;
+} perf_phase;
+
+
+class SfannPerf {
+
+    private:
+        static map<string, perf_phase> phases;
+        // noms des phases dans l'ordre de leur premiere apparition, pour le rapport
+        static vector<string> order;
+        static double start_time;
+
+        static string json_escape(const string & s);
+
+    public:
+        // horloge monotone, en secondes
+        static double now();
+
+        static void record(const string & phase, double seconds, unsigned long long items, unsigned long long bytes_read, unsigned long long bytes_allocated);
+        // NULL si la phase n'a jamais ete enregistree
+        static const perf_phase * get(const string & phase);
+        static const vector<string> & get_phases();
+        static double elapsed();
+        static void reset();
+
+        static void write_json(const string & file) throw (SfannException);
+};
+
+
+// Chronometre la portee englobante et l'enregistre sous <phase> a sa destruction
+class SfannPerfScope {
+
+    private:
+        string phase;
+        double start;
+        bool stopped;
+        unsigned long long items;
+        unsigned long long bytes_read;
+        unsigned long long bytes_allocated;
+
+    public:
+        SfannPerfScope(const string & phase);
+        ~SfannPerfScope();
+
+        // enregistre la phase tout de suite plutot qu'a la fin de la portee
+        void stop();
+
+        void add_items(unsigned long long n) {this->items += n;};
+        void add_bytes_read(unsigned long long n) {this->bytes_read += n;};
+        void add_bytes_allocated(unsigned long long n) {this->bytes_allocated += n;};
+};
+
+#endif
@@ -0,0 +1,93 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNRANDOM__
+#define __LIB_SFANNRANDOM__
+
+#include <vector>
+
+using namespace std;
+
+// Petit generateur aleatoire a graine (xorshift64*), pour qu'un run soit
+// reproductible avec le meme --seed sur toutes les plateformes, contrairement a rand()
+class SfannRandom {
+
+    private:
+        unsigned long long state;
+
+    public:
+        SfannRandom(unsigned long long seed = 1) {this->set_seed(seed);};
+
+        void set_seed(unsigned long long seed) {
+            // une etape de splitmix64, pour un bon etat non nul meme avec de petites graines
+            unsigned long long z = seed + 0x9E3779B97F4A7C15ULL;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            this->state = (z ^ (z >> 31)) | 1;
+        };
+
+        unsigned long long next() {
+            this->state ^= this->state >> 12;
+            this->state ^= this->state << 25;
+            this->state ^= this->state >> 27;
+            return this->state * 2685821657736338717ULL;
+        };
+
+        // uniforme dans [0, n[
+        unsigned int below(unsigned int n) {return (unsigned int)((this->next() >> 32) * n >> 32);};
+
+        // place au debut de <v> <k> elements tires uniformement parmi les siens (Fisher-Yates partiel)
+        template <class T> void partial_shuffle(vector<T> & v, size_t k) {
+            if (k > v.size()) k = v.size();
+            for (size_t i = 0; i < k; i++) {
+                size_t j = i + this->below(v.size() - i);
+                T tmp = v[i];
+                v[i] = v[j];
+                v[j] = tmp;
+            }
+        };
+
+        template <class T> void shuffle(vector<T> & v) {this->partial_shuffle(v, v.size());};
+
+        // melange les elements [begin, end[ de <v>
+        template <class T> void shuffle_range(vector<T> & v, size_t begin, size_t end) {
+            for (size_t i = begin; i + 1 < end; i++) {
+                size_t j = i + this->below(end - i);
+                T tmp = v[i];
+                v[i] = v[j];
+                v[j] = tmp;
+            }
+        };
+};
+
+#endif
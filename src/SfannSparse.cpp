@@ -0,0 +1,331 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannSparse.hpp"
+#include "SfannWeights.hpp"
+
+#include <cmath>
+#include <pthread.h>
+
+
+vector<text_block> SfannSparse::text_blocks;
+// les corpus sont lus en arriere-plan pendant que les autres sont codes
+static pthread_mutex_t text_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// fonctions d'activation traitees par les noyaux (celles de sfann), memes formules que FANN
+static bool is_supported_activation(unsigned int activation_function) {
+    return activation_function == FANN_LINEAR || activation_function == FANN_SIGMOID || activation_function == FANN_SIGMOID_SYMMETRIC;
+}
+
+// fin du calcul d'un neurone, comme dans fann_run
+static inline void activate(struct fann_neuron * neuron, fann_type sum) {
+    fann_type steepness = neuron->activation_steepness;
+    fann_type max_sum = 150 / steepness;
+    sum = sum * steepness;
+    if (sum > max_sum) sum = max_sum;
+    else if (sum < -max_sum) sum = -max_sum;
+    neuron->sum = sum;
+
+    switch (neuron->activation_function) {
+        case FANN_SIGMOID:
+            neuron->value = (fann_type)(1.0f / (1.0f + exp(-2.0f * sum)));
+            break;
+        case FANN_SIGMOID_SYMMETRIC:
+            neuron->value = (fann_type)(2.0f / (1.0f + exp(-2.0f * sum)) - 1.0f);
+            break;
+        default:
+            neuron->value = sum;
+            break;
+    }
+}
+
+
+void SfannSparse::add_text(const struct fann_train_data * data, unsigned int columns, unsigned long long values) {
+    if (data == NULL || data->num_data == 0 || data->input == NULL) return;
+    text_block b;
+    b.first = data->input[0];
+    b.last = data->input[0] + values;
+    b.columns = columns;
+    pthread_mutex_lock(&text_mutex);
+    SfannSparse::text_blocks.push_back(b);
+    pthread_mutex_unlock(&text_mutex);
+}
+
+void SfannSparse::forget_text(const struct fann_train_data * data) {
+    if (data == NULL || data->num_data == 0 || data->input == NULL) return;
+    pthread_mutex_lock(&text_mutex);
+    for (size_t b=0; b<SfannSparse::text_blocks.size(); b++) {
+        if (SfannSparse::text_blocks[b].first == data->input[0]) {
+            SfannSparse::text_blocks.erase(SfannSparse::text_blocks.begin() + b);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&text_mutex);
+}
+
+unsigned int SfannSparse::text_columns(const struct fann_train_data * data) {
+    if (data == NULL || data->num_data == 0 || data->input == NULL) return 0;
+    const fann_type * row = data->input[0];
+    unsigned int columns = 0;
+    pthread_mutex_lock(&text_mutex);
+    for (size_t b=0; b<SfannSparse::text_blocks.size(); b++) {
+        if (row >= SfannSparse::text_blocks[b].first && row < SfannSparse::text_blocks[b].last) {
+            columns = SfannSparse::text_blocks[b].columns;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&text_mutex);
+    return columns;
+}
+
+unsigned long long SfannSparse::text_values(const struct fann_train_data * data) {
+    if (data == NULL || data->num_data == 0 || data->input == NULL) return 0;
+    unsigned long long values = 0;
+    pthread_mutex_lock(&text_mutex);
+    for (size_t b=0; b<SfannSparse::text_blocks.size(); b++) {
+        if (SfannSparse::text_blocks[b].first == data->input[0]) {
+            values = (SfannSparse::text_blocks[b].last - SfannSparse::text_blocks[b].first) - (unsigned long long)data->num_data * data->num_input;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&text_mutex);
+    return values;
+}
+
+sparse_inputs * SfannSparse::encode(const struct fann_train_data * data) {
+    sparse_inputs * s = new sparse_inputs;
+    s->data = data;
+    unsigned int num_input = data->num_input;
+    unsigned int num_data = data->num_data;
+    unsigned int num_text = text_columns(data);
+
+    // une colonne est a -1/1 si aucun exemple n'a d'autre valeur
+    vector<char> binary(num_input, 1);
+    for (unsigned int i=0; i<num_data; i++) {
+        const fann_type * in = data->input[i];
+        for (unsigned int c=0; c<num_input; c++) {
+            if (in[c] != 1 && in[c] != -1) binary[c] = 0;
+        }
+    }
+    for (unsigned int c=0; c<num_input; c++) {
+        if (binary[c]) s->binary_columns.push_back(c);
+        else s->dense_columns.push_back(c);
+    }
+    size_t num_binary = s->binary_columns.size();
+    for (unsigned int t=0; t<num_text; t++) s->binary_columns.push_back(num_input + t);
+
+    s->row_start.reserve(num_data + 1);
+    s->row_start.push_back(0);
+    for (unsigned int i=0; i<num_data; i++) {
+        const fann_type * in = data->input[i];
+        for (size_t k=0; k<num_binary; k++) {
+            if (in[s->binary_columns[k]] == 1) s->active.push_back(s->binary_columns[k]);
+        }
+        // compartiments texte a 1, ranges apres les entrees denses
+        if (num_text > 0) {
+            unsigned int count = (unsigned int)in[num_input];
+            for (unsigned int k=1; k<=count; k++) s->active.push_back(num_input + (unsigned int)in[num_input + k]);
+        }
+        s->row_start.push_back(s->active.size());
+    }
+
+    return s;
+}
+
+void SfannSparse::destroy(sparse_inputs * & s) {
+    delete s;
+    s = NULL;
+}
+
+unsigned long long SfannSparse::size(const sparse_inputs * s) {
+    if (s == NULL) return 0;
+    return sizeof(sparse_inputs) + (unsigned long long)(s->binary_columns.size() + s->dense_columns.size() + s->row_start.size() + s->active.size()) * sizeof(unsigned int);
+}
+
+bool SfannSparse::worthwhile(const sparse_inputs * s) {
+    if (s == NULL || s->binary_columns.empty()) return false;
+    unsigned long long dense = (unsigned long long)s->data->num_data * (s->binary_columns.size() + s->dense_columns.size());
+    unsigned long long sparse = (unsigned long long)s->data->num_data * s->dense_columns.size() + s->active.size();
+    return 2 * sparse <= dense;
+}
+
+bool SfannSparse::supports(const struct fann * net) {
+    if (net == NULL || net->network_type != FANN_NETTYPE_LAYER || net->connection_rate < 1) return false;
+    if (net->last_layer - net->first_layer < 2) return false;
+
+    for (struct fann_layer * layer = net->first_layer + 1; layer != net->last_layer; ++layer) {
+        for (struct fann_neuron * neuron = layer->first_neuron; neuron != layer->last_neuron; ++neuron) {
+            if (neuron->first_con == neuron->last_con) continue;
+            if (!is_supported_activation(neuron->activation_function)) return false;
+            // toutes les entrees puis le biais, dans l'ordre
+            if (layer == net->first_layer + 1 && neuron->last_con - neuron->first_con != net->num_input + 1) return false;
+        }
+    }
+    return true;
+}
+
+void SfannSparse::baseline(struct fann * net, const sparse_inputs * s, vector<fann_type> & base) {
+    struct fann_layer * hidden = net->first_layer + 1;
+    base.assign(hidden->last_neuron - hidden->first_neuron, 0);
+    for (struct fann_neuron * neuron = hidden->first_neuron; neuron != hidden->last_neuron; ++neuron) {
+        if (neuron->first_con == neuron->last_con) continue;
+        const fann_type * w = net->weights + neuron->first_con;
+        fann_type b = w[net->num_input];
+        for (size_t k=0; k<s->binary_columns.size(); k++) b -= w[s->binary_columns[k]];
+        base[neuron - hidden->first_neuron] = b;
+    }
+}
+
+fann_type * SfannSparse::run(struct fann * net, const sparse_inputs * s, const vector<fann_type> & base, unsigned int i) {
+    struct fann_layer * hidden = net->first_layer + 1;
+    const fann_type * in = s->data->input[i];
+    unsigned int num_dense = s->dense_columns.size();
+    unsigned int active_start = s->row_start[i], active_end = s->row_start[i+1];
+
+    for (struct fann_neuron * neuron = hidden->first_neuron; neuron != hidden->last_neuron; ++neuron) {
+        if (neuron->first_con == neuron->last_con) {
+            // biais
+            neuron->value = 1;
+            continue;
+        }
+        const fann_type * w = net->weights + neuron->first_con;
+        fann_type sum = base[neuron - hidden->first_neuron];
+        for (unsigned int k=0; k<num_dense; k++) {
+            unsigned int c = s->dense_columns[k];
+            sum += w[c] * in[c];
+        }
+        for (unsigned int k=active_start; k<active_end; k++) {
+            sum += 2 * w[s->active[k]];
+        }
+        activate(neuron, sum);
+    }
+
+    // couches suivantes : comme fann_run
+    for (struct fann_layer * layer = hidden + 1; layer != net->last_layer; ++layer) {
+        const struct fann_neuron * prev = (layer - 1)->first_neuron;
+        for (struct fann_neuron * neuron = layer->first_neuron; neuron != layer->last_neuron; ++neuron) {
+            if (neuron->first_con == neuron->last_con) {
+                neuron->value = 1;
+                continue;
+            }
+            const fann_type * w = net->weights + neuron->first_con;
+            unsigned int num_connections = neuron->last_con - neuron->first_con;
+            fann_type sum = 0;
+            for (unsigned int k=0; k<num_connections; k++) {
+                sum += w[k] * prev[k].value;
+            }
+            activate(neuron, sum);
+        }
+    }
+
+    const struct fann_neuron * last = (net->last_layer - 1)->first_neuron;
+    for (unsigned int k=0; k<net->num_output; k++) {
+        net->output[k] = last[k].value;
+    }
+    return net->output;
+}
+
+float SfannSparse::train_epoch(struct fann * net, const sparse_inputs * s) {
+    if (fann_get_training_algorithm(net) != FANN_TRAIN_RPROP) {
+        return fann_train_epoch(net, (struct fann_train_data *) s->data);
+    }
+    // meme deroulement que fann_train_epoch_irpropm
+    if (net->prev_train_slopes == NULL) fann_clear_train_arrays(net);
+    if (net->train_slopes == NULL) {
+        return fann_train_epoch(net, (struct fann_train_data *) s->data);
+    }
+    fann_reset_MSE(net);
+    train_slopes(net, s);
+    fann_update_weights_irpropm(net, 0, net->total_connections);
+    return fann_get_MSE(net);
+}
+
+void SfannSparse::train_slopes(struct fann * net, const sparse_inputs * s) {
+    struct fann_layer * hidden = net->first_layer + 1;
+    unsigned int num_neurons = hidden->last_neuron - hidden->first_neuron;
+    unsigned int first_neuron = hidden->first_neuron - net->first_layer->first_neuron;
+    unsigned int num_dense = s->dense_columns.size();
+    bool more_layers = net->last_layer - net->first_layer > 2;
+
+    vector<fann_type> base;
+    baseline(net, s, base);
+    // somme des erreurs de chaque neurone : part commune des colonnes a -1/1 et du biais
+    vector<fann_type> error_sum(num_neurons, 0);
+    bool weighted = SfannWeights::weighted(s->data);
+
+    for (unsigned int i=0; i<s->data->num_data; i++) {
+        run(net, s, base, i);
+        SfannWeights::compute_MSE(net, s->data->output[i], weighted ? SfannWeights::weight(s->data, i) : 1);
+        fann_backpropagate_MSE(net);
+        if (more_layers) fann_update_slopes_batch(net, hidden + 1, net->last_layer - 1);
+
+        const fann_type * in = s->data->input[i];
+        const fann_type * errors = net->train_errors + first_neuron;
+        unsigned int active_start = s->row_start[i], active_end = s->row_start[i+1];
+        for (unsigned int h=0; h<num_neurons; h++) {
+            struct fann_neuron * neuron = hidden->first_neuron + h;
+            if (neuron->first_con == neuron->last_con) continue;
+            fann_type e = errors[h];
+            fann_type * slope = net->train_slopes + neuron->first_con;
+            for (unsigned int k=0; k<num_dense; k++) {
+                unsigned int c = s->dense_columns[k];
+                slope[c] += e * in[c];
+            }
+            for (unsigned int k=active_start; k<active_end; k++) {
+                slope[s->active[k]] += 2 * e;
+            }
+            error_sum[h] += e;
+        }
+    }
+
+    // -e par exemple pour les colonnes a -1/1, +e pour le biais
+    for (unsigned int h=0; h<num_neurons; h++) {
+        struct fann_neuron * neuron = hidden->first_neuron + h;
+        if (neuron->first_con == neuron->last_con) continue;
+        fann_type * slope = net->train_slopes + neuron->first_con;
+        for (size_t k=0; k<s->binary_columns.size(); k++) slope[s->binary_columns[k]] -= error_sum[h];
+        slope[net->num_input] += error_sum[h];
+    }
+}
+
+float SfannSparse::test_data(struct fann * net, const sparse_inputs * s) {
+    fann_reset_MSE(net);
+    vector<fann_type> base;
+    baseline(net, s, base);
+    bool weighted = SfannWeights::weighted(s->data);
+    for (unsigned int i=0; i<s->data->num_data; i++) {
+        run(net, s, base, i);
+        SfannWeights::compute_MSE(net, s->data->output[i], weighted ? SfannWeights::weight(s->data, i) : 1);
+    }
+    return fann_get_MSE(net);
+}
@@ -0,0 +1,121 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNSPARSE__
+#define __LIB_SFANNSPARSE__
+
+#include <vector>
+#include "fann.h"
+
+using namespace std;
+
+// Codage creux des entrees d'un corpus.
+//
+// Les parametres a etiquettes (Icsiboost) et les codages one-hot donnent des
+// colonnes qui ne valent que -1 ou 1, avec tres peu de 1 par exemple : ces
+// colonnes sont representees par la liste des colonnes a 1 de chaque exemple,
+// les autres colonnes (continues) restent lues dans le corpus.
+typedef struct sparse_inputs {
+    // corpus code, qui doit rester alloue (ordre des exemples compris)
+    const struct fann_train_data * data;
+    // colonnes a -1/1 et autres colonnes
+    vector<unsigned int> binary_columns;
+    vector<unsigned int> dense_columns;
+    // colonnes a 1 de l'exemple i : active[row_start[i]] .. active[row_start[i+1] - 1]
+    vector<unsigned int> row_start;
+    vector<unsigned int> active;
+} sparse_inputs;
+
+
+// Entrees texte creuses (parametres texte Icsiboost).
+//
+// Les compartiments des parametres texte ne sont pas ranges dans les entrees
+// du corpus : chaque exemple range, apres ses num_input entrees denses, le
+// nombre de ses compartiments a 1 puis leurs numeros (de 0 a text_columns - 1,
+// croissants). Le reseau a num_input + text_columns entrees, les compartiments
+// en dernier. Comme les poids de SfannWeights, ces listes suivent les vues du
+// corpus sans autre table ; les exemples ne passent que par les noyaux creux.
+typedef struct text_block {
+    // entrees du corpus (debut et fin du bloc)
+    const fann_type * first, * last;
+    unsigned int columns;
+} text_block;
+
+
+// Noyaux de la premiere couche cachee sur les entrees creuses : pour une
+// colonne c a -1/1, w.x = -w + 2.w.[x = 1], la somme des -w (et le biais) est
+// calculee une fois par neurone, et seules les colonnes a 1 sont ajoutees.
+// Les resultats sont ceux de fann_run / fann_train_epoch (RPROP), au
+// regroupement des additions pres.
+class SfannSparse {
+
+    private:
+        // corpus a entrees texte creuses
+        static vector<text_block> text_blocks;
+
+    public:
+        // enregistre <data>, dont les exemples sont ranges dans un seul bloc de <values> valeurs d'entree
+        static void add_text(const struct fann_train_data * data, unsigned int columns, unsigned long long values);
+        // a appeler avant de liberer un corpus enregistre par add_text
+        static void forget_text(const struct fann_train_data * data);
+        // colonnes texte de <data> (ou du corpus dont c'est une vue), 0 s'il n'en a pas
+        static unsigned int text_columns(const struct fann_train_data * data);
+        // valeurs rangees apres les entrees denses de tous les exemples d'un corpus enregistre (pas d'une vue)
+        static unsigned long long text_values(const struct fann_train_data * data);
+        // entrees du reseau pour <data> : num_input plus les colonnes texte
+        static unsigned int num_inputs(const struct fann_train_data * data) {return data->num_input + text_columns(data);};
+
+        // les colonnes texte d'un corpus enregistre par add_text sont des colonnes a -1/1
+        static sparse_inputs * encode(const struct fann_train_data * data);
+        static void destroy(sparse_inputs * & s);
+        // taille memoire du codage
+        static unsigned long long size(const sparse_inputs * s);
+        // vrai si le codage divise au moins par deux le travail de la premiere couche
+        static bool worthwhile(const sparse_inputs * s);
+        // reseau en couches, premiere couche cachee completement connectee aux entrees
+        static bool supports(const struct fann * net);
+
+        // somme constante (biais et -w des colonnes a -1/1) de chaque neurone de la premiere couche cachee,
+        // a recalculer a chaque modification des poids
+        static void baseline(struct fann * net, const sparse_inputs * s, vector<fann_type> & base);
+        // equivalent de fann_run sur l'exemple <i> du corpus code
+        static fann_type * run(struct fann * net, const sparse_inputs * s, const vector<fann_type> & base, unsigned int i);
+        // equivalents de fann_train_epoch (RPROP) et fann_test_data
+        static float train_epoch(struct fann * net, const sparse_inputs * s);
+        // partie de train_epoch propre aux exemples : ajoute leurs pentes (train_slopes) et leur erreur (MSE) ;
+        // les tableaux d'apprentissage doivent etre alloues
+        static void train_slopes(struct fann * net, const sparse_inputs * s);
+        static float test_data(struct fann * net, const sparse_inputs * s);
+};
+
+#endif
@@ -0,0 +1,242 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannStream.hpp"
+#include "SfannParse.hpp"
+#include "SfannSparse.hpp"
+
+
+SfannStream::SfannStream(const string & file, unsigned long long budget) throw (SfannException) {
+    this->file = file;
+    this->thread_started = false;
+    this->stop = false;
+    this->bytes = 0;
+    this->current = 0;
+    this->buffers[0] = NULL;
+    this->buffers[1] = NULL;
+    this->full[0] = false;
+    this->full[1] = false;
+
+    unsigned int num_input, num_output;
+    {
+        SfannNumberReader reader(file);
+        SfannParse::read_fann_header(reader, file, this->num_data, num_input, num_output);
+    }
+    if (this->num_data == 0) {
+        throw SfannException("No example in " + file + " !");
+    }
+
+    unsigned long long example_size = (num_input + num_output) * sizeof(fann_type) + 2 * sizeof(fann_type *);
+    unsigned long long block = budget / (2 * example_size);
+    if (block < 1) block = 1;
+    if (block > this->num_data) block = this->num_data;
+    this->block_size = (unsigned int)block;
+
+    this->header_data = new struct fann_train_data;
+    this->header_data->errno_f = FANN_E_NO_ERROR;
+    this->header_data->error_log = NULL;
+    this->header_data->errstr = NULL;
+    this->header_data->num_data = this->num_data;
+    this->header_data->num_input = num_input;
+    this->header_data->num_output = num_output;
+    this->header_data->input = NULL;
+    this->header_data->output = NULL;
+
+    for (int b=0; b<2; b++) {
+        this->buffers[b] = fann_create_train(this->block_size, num_input, num_output);
+        if (this->buffers[b] == NULL) {
+            this->release_buffers();
+            throw SfannException("Impossible allocation of the stream buffers of " + file + " !");
+        }
+    }
+
+    pthread_mutex_init(&this->mutex, NULL);
+    pthread_cond_init(&this->cond, NULL);
+    if (pthread_create(&this->thread, NULL, prefetch, this) != 0) {
+        pthread_mutex_destroy(&this->mutex);
+        pthread_cond_destroy(&this->cond);
+        this->release_buffers();
+        throw SfannException("Impossible creation of the reading thread of " + file + " !");
+    }
+    this->thread_started = true;
+}
+
+SfannStream::~SfannStream() {
+    if (this->thread_started) {
+        pthread_mutex_lock(&this->mutex);
+        this->stop = true;
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+        pthread_join(this->thread, NULL);
+        pthread_mutex_destroy(&this->mutex);
+        pthread_cond_destroy(&this->cond);
+        this->thread_started = false;
+    }
+    this->release_buffers();
+}
+
+void SfannStream::release_buffers() {
+    for (int b=0; b<2; b++) {
+        if (this->buffers[b] != NULL) {
+            // fann_destroy_train ne depend pas de num_data
+            fann_destroy_train(this->buffers[b]);
+            this->buffers[b] = NULL;
+        }
+    }
+    delete this->header_data;
+    this->header_data = NULL;
+}
+
+unsigned long long SfannStream::size() {
+    struct fann_train_data * h = this->header_data;
+    return 2ULL * this->block_size * ((h->num_input + h->num_output) * sizeof(fann_type) + 2 * sizeof(fann_type *));
+}
+
+unsigned long long SfannStream::take_bytes_read() {
+    pthread_mutex_lock(&this->mutex);
+    unsigned long long b = this->bytes;
+    this->bytes = 0;
+    pthread_mutex_unlock(&this->mutex);
+    return b;
+}
+
+void * SfannStream::prefetch(void * stream) {
+    ((SfannStream *) stream)->read_blocks();
+    return NULL;
+}
+
+// thread de lecture : remplit les tampons a tour de role, en reprenant le fichier au debut a chaque epoque
+void SfannStream::read_blocks() {
+    int b = 0;
+    try {
+        while (true) {
+            SfannNumberReader reader(this->file);
+            unsigned int num_data, num_input, num_output;
+            SfannParse::read_fann_header(reader, this->file, num_data, num_input, num_output);
+            unsigned long long counted = 0;
+
+            for (unsigned int done = 0; done < this->num_data; ) {
+                pthread_mutex_lock(&this->mutex);
+                while (this->full[b] && !this->stop) pthread_cond_wait(&this->cond, &this->mutex);
+                bool stop = this->stop;
+                pthread_mutex_unlock(&this->mutex);
+                if (stop) return;
+
+                unsigned int count = this->num_data - done < this->block_size ? this->num_data - done : this->block_size;
+                this->buffers[b]->num_data = count;
+                SfannParse::read_fann_examples(reader, this->file, this->buffers[b], done, count);
+                done += count;
+
+                pthread_mutex_lock(&this->mutex);
+                this->bytes += reader.bytes_read() - counted;
+                counted = reader.bytes_read();
+                this->full[b] = true;
+                pthread_cond_broadcast(&this->cond);
+                pthread_mutex_unlock(&this->mutex);
+                b ^= 1;
+            }
+        }
+    } catch (SfannException & e) {
+        // rendue par next_block
+        pthread_mutex_lock(&this->mutex);
+        this->error = e.message;
+        if (this->error.empty()) this->error = "Error while reading " + this->file;
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+    } catch (exception & e) {
+        // bad_alloc... : rendue de la meme facon, une exception ne doit pas sortir du thread
+        pthread_mutex_lock(&this->mutex);
+        this->error = "Error while reading " + this->file + " : " + e.what();
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+    }
+}
+
+struct fann_train_data * SfannStream::next_block() throw (SfannException) {
+    pthread_mutex_lock(&this->mutex);
+    while (!this->full[this->current] && this->error.empty()) pthread_cond_wait(&this->cond, &this->mutex);
+    bool ready = this->full[this->current];
+    string error = this->error;
+    pthread_mutex_unlock(&this->mutex);
+    if (!ready) {
+        throw SfannException(error);
+    }
+    return this->buffers[this->current];
+}
+
+void SfannStream::release_block() {
+    pthread_mutex_lock(&this->mutex);
+    this->full[this->current] = false;
+    pthread_cond_broadcast(&this->cond);
+    pthread_mutex_unlock(&this->mutex);
+    this->current ^= 1;
+}
+
+void SfannStream::train_slopes(struct fann * net, struct fann_train_data * block) {
+    for (unsigned int i=0; i<block->num_data; i++) {
+        fann_run(net, block->input[i]);
+        fann_compute_MSE(net, block->output[i]);
+        fann_backpropagate_MSE(net);
+        fann_update_slopes_batch(net, net->first_layer + 1, net->last_layer - 1);
+    }
+}
+
+float SfannStream::train_epoch(struct fann * net, const string & encoding) throw (SfannException) {
+    if (fann_get_training_algorithm(net) != FANN_TRAIN_RPROP) {
+        throw SfannException("The out-of-core training needs the RPROP algorithm");
+    }
+    // meme deroulement que fann_train_epoch_irpropm, les exemples arrivant par blocs
+    if (net->prev_train_slopes == NULL) fann_clear_train_arrays(net);
+    fann_reset_MSE(net);
+
+    bool sparse = encoding != "dense" && SfannSparse::supports(net);
+    for (unsigned int done = 0; done < this->num_data; ) {
+        struct fann_train_data * block = this->next_block();
+        sparse_inputs * s = NULL;
+        if (sparse) {
+            s = SfannSparse::encode(block);
+            if (s->binary_columns.empty() || (encoding == "auto" && !SfannSparse::worthwhile(s))) SfannSparse::destroy(s);
+        }
+        if (s != NULL) {
+            SfannSparse::train_slopes(net, s);
+            SfannSparse::destroy(s);
+        } else {
+            train_slopes(net, block);
+        }
+        done += block->num_data;
+        this->release_block();
+    }
+
+    fann_update_weights_irpropm(net, 0, net->total_connections);
+    return fann_get_MSE(net);
+}
@@ -0,0 +1,101 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNSTREAM__
+#define __LIB_SFANNSTREAM__
+
+#include <string>
+#include <pthread.h>
+#include "fann.h"
+#include "SfannException.hpp"
+
+using namespace std;
+
+// Apprentissage hors memoire : le fichier de train (format FANN) est relu
+// par blocs a chaque epoque, au lieu d'etre charge en entier.
+//
+// Deux tampons de block_size exemples : un thread lit le bloc suivant
+// pendant que l'apprentissage traite le bloc courant. L'apprentissage est
+// celui de fann_train_epoch en RPROP (pentes cumulees sur toute l'epoque,
+// poids mis a jour a la fin), il ne depend donc pas du decoupage en blocs.
+class SfannStream {
+
+    private:
+        string file;
+        unsigned int num_data;
+        unsigned int block_size;
+        // num_data / num_input / num_output du fichier, sans exemples, pour le reste du programme
+        struct fann_train_data * header_data;
+        struct fann_train_data * buffers[2];
+
+        // etat partage avec le thread de lecture, protege par <mutex>
+        bool full[2];
+        bool stop;
+        string error;
+        unsigned long long bytes;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        pthread_t thread;
+        bool thread_started;
+        // tampon rendu par next_block
+        int current;
+
+        static void * prefetch(void * stream);
+        void read_blocks();
+        void release_buffers();
+
+        // pentes et erreur des exemples de <block>, entrees denses
+        static void train_slopes(struct fann * net, struct fann_train_data * block);
+
+    public:
+        // les deux tampons tiennent dans <budget> octets (au moins un exemple chacun)
+        SfannStream(const string & file, unsigned long long budget) throw (SfannException);
+        ~SfannStream();
+
+        struct fann_train_data * header() {return this->header_data;};
+        unsigned int get_block_size() {return this->block_size;};
+        // memoire des tampons
+        unsigned long long size();
+        // octets lus dans le fichier depuis le dernier appel
+        unsigned long long take_bytes_read();
+
+        // bloc suivant (les blocs d'une epoque dans l'ordre du fichier, puis ceux de l'epoque suivante),
+        // a rendre par release_block avant de demander le suivant
+        struct fann_train_data * next_block() throw (SfannException);
+        void release_block();
+
+        // une epoque RPROP sur tout le fichier ; <encoding> comme --input-encoding pour chaque bloc
+        float train_epoch(struct fann * net, const string & encoding) throw (SfannException);
+};
+
+#endif
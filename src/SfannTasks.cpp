@@ -0,0 +1,219 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#include "SfannTasks.hpp"
+
+#include <new>
+
+
+SfannTasks::SfannTasks(unsigned int num_workers) {
+    this->num_workers = num_workers < 1 ? 1 : num_workers;
+    this->error_task = 0;
+    this->num_finished = 0;
+    pthread_mutex_init(&this->mutex, NULL);
+    pthread_cond_init(&this->finished_cond, NULL);
+    for (unsigned int w=0; w<this->num_workers; w++) {
+        task_queue * q = new task_queue;
+        pthread_mutex_init(&q->mutex, NULL);
+        this->queues.push_back(q);
+    }
+}
+
+SfannTasks::~SfannTasks() {
+    for (size_t w=0; w<this->queues.size(); w++) {
+        pthread_mutex_destroy(&this->queues[w]->mutex);
+        delete this->queues[w];
+    }
+    pthread_cond_destroy(&this->finished_cond);
+    pthread_mutex_destroy(&this->mutex);
+}
+
+unsigned int SfannTasks::add(SfannTask * task) {
+    unsigned int i = this->tasks.size();
+    this->tasks.push_back(task);
+    this->cancelled.push_back(0);
+    this->after.push_back(-1);
+    this->finished.push_back(0);
+    this->queues[i % this->num_workers]->tasks.push_back(i);
+    return i;
+}
+
+unsigned int SfannTasks::add(SfannTask * task, unsigned int after) {
+    unsigned int i = this->add(task);
+    if (after < i) this->after[i] = after;
+    return i;
+}
+
+void SfannTasks::cancel(unsigned int task) {
+    pthread_mutex_lock(&this->mutex);
+    this->cancelled[task] = 1;
+    pthread_mutex_unlock(&this->mutex);
+}
+
+void SfannTasks::cancel_all() {
+    pthread_mutex_lock(&this->mutex);
+    this->cancelled.assign(this->cancelled.size(), 1);
+    pthread_mutex_unlock(&this->mutex);
+}
+
+bool SfannTasks::is_cancelled(unsigned int task) {
+    pthread_mutex_lock(&this->mutex);
+    bool res = this->cancelled[task];
+    pthread_mutex_unlock(&this->mutex);
+    return res;
+}
+
+void SfannTasks::fail(unsigned int task, const string & what) {
+    pthread_mutex_lock(&this->mutex);
+    if (this->error.empty() || task < this->error_task) {
+        this->error = what;
+        this->error_task = task;
+    }
+    // les taches d'indice plus petit continuent : l'une d'elles peut encore echouer, et c'est son erreur qui sera rendue
+    for (size_t t=task+1; t<this->cancelled.size(); t++) this->cancelled[t] = 1;
+    pthread_mutex_unlock(&this->mutex);
+}
+
+bool SfannTasks::take_ready(task_queue * q, bool last, unsigned int & task) {
+    // ordre des verrous : la file, puis l'etat partage
+    pthread_mutex_lock(&q->mutex);
+    pthread_mutex_lock(&this->mutex);
+    bool found = false;
+    size_t n = q->tasks.size();
+    for (size_t k=0; k<n && !found; k++) {
+        size_t pos = last ? n - 1 - k : k;
+        int needed = this->after[q->tasks[pos]];
+        if (needed < 0 || this->finished[needed]) {
+            task = q->tasks[pos];
+            q->tasks.erase(q->tasks.begin() + pos);
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&this->mutex);
+    pthread_mutex_unlock(&q->mutex);
+    return found;
+}
+
+bool SfannTasks::next_task(unsigned int worker, unsigned int & task) {
+    while (true) {
+        pthread_mutex_lock(&this->mutex);
+        unsigned int seen = this->num_finished;
+        pthread_mutex_unlock(&this->mutex);
+
+        // sa propre file, dans l'ordre
+        if (this->take_ready(this->queues[worker], false, task)) return true;
+
+        // sinon vol dans les autres files, de la plus chargee a la moins chargee, par la fin (les taches les plus loin
+        // d'etre commencees)
+        vector<size_t> sizes(this->num_workers, 0);
+        for (unsigned int w=0; w<this->num_workers; w++) {
+            pthread_mutex_lock(&this->queues[w]->mutex);
+            sizes[w] = this->queues[w]->tasks.size();
+            pthread_mutex_unlock(&this->queues[w]->mutex);
+        }
+        bool pending = sizes[worker] > 0;
+        sizes[worker] = 0;
+        while (true) {
+            unsigned int victim = worker;
+            size_t most = 0;
+            for (unsigned int w=0; w<this->num_workers; w++) {
+                if (sizes[w] > most) {
+                    most = sizes[w];
+                    victim = w;
+                }
+            }
+            if (most == 0) break;
+            sizes[victim] = 0;
+            if (this->take_ready(this->queues[victim], true, task)) return true;
+            pending = true;
+        }
+        if (!pending) return false;
+
+        // il reste des taches, qui attendent toutes une tache en cours
+        pthread_mutex_lock(&this->mutex);
+        while (this->num_finished == seen) pthread_cond_wait(&this->finished_cond, &this->mutex);
+        pthread_mutex_unlock(&this->mutex);
+    }
+}
+
+void SfannTasks::finish(unsigned int task) {
+    pthread_mutex_lock(&this->mutex);
+    this->finished[task] = 1;
+    this->num_finished++;
+    pthread_cond_broadcast(&this->finished_cond);
+    pthread_mutex_unlock(&this->mutex);
+}
+
+void * SfannTasks::start_worker(void * arg) {
+    worker_arg * a = (worker_arg *)arg;
+    a->pool->work(a->worker);
+    return NULL;
+}
+
+void SfannTasks::work(unsigned int worker) {
+    unsigned int task;
+    while (this->next_task(worker, task)) {
+        if (!this->is_cancelled(task)) {
+            try {
+                this->tasks[task]->run(worker);
+            } catch (SfannException & e) {
+                this->fail(task, e.what());
+            } catch (bad_alloc & e) {
+                this->fail(task, "Not enough memory");
+            } catch (exception & e) {
+                this->fail(task, e.what());
+            }
+        }
+        this->finish(task);
+    }
+}
+
+void SfannTasks::run() throw (SfannException) {
+    vector<worker_arg> args(this->num_workers);
+    vector<pthread_t> threads;
+    for (unsigned int w=1; w<this->num_workers; w++) {
+        args[w].pool = this;
+        args[w].worker = w;
+        pthread_t thread;
+        // sans thread, sa file sera volee par les autres
+        if (pthread_create(&thread, NULL, start_worker, &args[w]) == 0) threads.push_back(thread);
+    }
+    this->work(0);
+    for (size_t t=0; t<threads.size(); t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    if (!this->error.empty()) {
+        throw SfannException(this->error);
+    }
+}
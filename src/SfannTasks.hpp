@@ -0,0 +1,132 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNTASKS__
+#define __LIB_SFANNTASKS__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <pthread.h>
+#include "SfannException.hpp"
+
+using namespace std;
+
+// Un calcul independant confie a SfannTasks. Son resultat est range par la
+// tache elle-meme a une place fixee a sa creation (son indice par exemple),
+// pour que l'agregation ne depende pas de l'ordre dans lequel les taches se
+// terminent.
+class SfannTask {
+
+    public:
+        virtual ~SfannTask() {}
+        // <worker> : numero (0 .. num_workers - 1) du thread qui execute la tache, pour un etat propre a chaque thread
+        virtual void run(unsigned int worker) throw (SfannException) = 0;
+};
+
+
+// Execution de taches de couts inegaux sur plusieurs threads, par vol de travail.
+//
+// Les taches sont distribuees a tour de role dans une file par thread.
+// Chaque thread prend ses taches dans l'ordre. Quand sa file est vide, il
+// vole la derniere tache de la file la plus chargee. Tous les threads
+// restent donc occupes jusqu'a la derniere tache.
+//
+// Une tache peut dependre d'une tache ajoutee avant elle : elle ne commence
+// qu'une fois celle-ci terminee, et peut donc se comparer a son resultat
+// complet quel que soit le nombre de threads (--cancel-behind). Un thread
+// dont aucune tache n'est prete attend la fin d'une tache en cours.
+//
+// Une tache annulee avant son debut n'est pas executee. Une tache en cours
+// peut consulter is_cancelled pour s'arreter plus tot. Une erreur annule les
+// taches d'indice plus grand ; celles d'indice plus petit vont a leur terme,
+// si bien que l'erreur relancee par run est toujours celle de la tache de
+// plus petit indice qui echoue, quel que soit l'ordre d'execution.
+class SfannTasks {
+
+    private:
+        typedef struct task_queue {
+            pthread_mutex_t mutex;
+            deque<unsigned int> tasks;
+        } task_queue;
+
+        unsigned int num_workers;
+        vector<SfannTask *> tasks;
+        vector<task_queue *> queues;
+
+        // etat partage, protege par <mutex>
+        pthread_mutex_t mutex;
+        vector<char> cancelled;
+        string error;
+        unsigned int error_task;
+        // tache attendue par chaque tache (-1 : aucune), taches terminees (executees, annulees ou en echec)
+        vector<int> after;
+        vector<char> finished;
+        unsigned int num_finished;
+        // signale a chaque tache terminee
+        pthread_cond_t finished_cond;
+
+        typedef struct worker_arg {
+            SfannTasks * pool;
+            unsigned int worker;
+        } worker_arg;
+
+        static void * start_worker(void * arg);
+        void work(unsigned int worker);
+        // prochaine tache de <worker>, faux s'il n'en reste plus nulle part
+        bool next_task(unsigned int worker, unsigned int & task);
+        // retire de <q> sa premiere tache prete (la derniere si <last>), faux si aucune ne l'est
+        bool take_ready(task_queue * q, bool last, unsigned int & task);
+        void finish(unsigned int task);
+        void fail(unsigned int task, const string & what);
+
+    public:
+        SfannTasks(unsigned int num_workers);
+        ~SfannTasks();
+
+        // ajoute une tache (avant run), qui reste a l'appelant ; rend son indice
+        unsigned int add(SfannTask * task);
+        // idem, la tache ne commencant qu'apres la tache <after> (deja ajoutee)
+        unsigned int add(SfannTask * task, unsigned int after);
+        unsigned int size() {return this->tasks.size();};
+        unsigned int get_num_workers() {return this->num_workers;};
+
+        // execute toutes les taches (le thread appelant est le thread 0)
+        void run() throw (SfannException);
+
+        void cancel(unsigned int task);
+        void cancel_all();
+        bool is_cancelled(unsigned int task);
+};
+
+#endif
@@ -0,0 +1,170 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+
+#include "SfannWeights.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+vector< pair<const fann_type *, const fann_type *> > SfannWeights::blocks;
+
+
+// FNV-1a des entrees et des sorties de l'exemple <i>
+static unsigned long long row_hash(const struct fann_train_data * data, unsigned int i) {
+    unsigned long long h = 14695981039346656037ULL;
+    const unsigned char * p = (const unsigned char *) data->input[i];
+    for (size_t k=0; k<data->num_input * sizeof(fann_type); k++) h = (h ^ p[k]) * 1099511628211ULL;
+    p = (const unsigned char *) data->output[i];
+    for (size_t k=0; k<data->num_output * sizeof(fann_type); k++) h = (h ^ p[k]) * 1099511628211ULL;
+    return h;
+}
+
+static bool same_row(const struct fann_train_data * data, unsigned int i, unsigned int j) {
+    return memcmp(data->input[i], data->input[j], data->num_input * sizeof(fann_type)) == 0
+        && memcmp(data->output[i], data->output[j], data->num_output * sizeof(fann_type)) == 0;
+}
+
+
+struct fann_train_data * SfannWeights::collapse(const struct fann_train_data * data) {
+    unsigned int num_data = data->num_data;
+    unsigned int num_input = data->num_input;
+    unsigned int num_output = data->num_output;
+
+    // les exemples de meme empreinte se suivent, chacun est rapporte a la premiere occurrence de sa valeur
+    vector< pair<unsigned long long, unsigned int> > keys(num_data);
+    for (unsigned int i=0; i<num_data; i++) keys[i] = make_pair(row_hash(data, i), i);
+    sort(keys.begin(), keys.end());
+
+    vector<unsigned int> first(num_data);
+    vector<unsigned int> count(num_data, 0);
+    vector<unsigned int> distinct;
+    for (size_t g=0; g<keys.size(); ) {
+        size_t end = g;
+        while (end < keys.size() && keys[end].first == keys[g].first) end++;
+        distinct.clear();
+        for (size_t k=g; k<end; k++) {
+            unsigned int i = keys[k].second;
+            size_t d = 0;
+            while (d < distinct.size() && !same_row(data, distinct[d], i)) d++;
+            if (d == distinct.size()) distinct.push_back(i);
+            first[i] = distinct[d];
+            count[distinct[d]]++;
+        }
+        g = end;
+    }
+
+    unsigned int num_unique = 0;
+    for (unsigned int i=0; i<num_data; i++) {
+        if (first[i] == i) num_unique++;
+    }
+
+    // une colonne de plus pour le poids, un seul bloc comme le lecteur FANN (libere par fann_destroy_train)
+    struct fann_train_data * res = fann_create_train(num_unique, num_input + 1, num_output);
+    res->num_input = num_input;
+    unsigned int n = 0;
+    for (unsigned int i=0; i<num_data; i++) {
+        if (first[i] != i) continue;
+        memcpy(res->input[n], data->input[i], num_input * sizeof(fann_type));
+        res->input[n][num_input] = (fann_type)count[i];
+        memcpy(res->output[n], data->output[i], num_output * sizeof(fann_type));
+        n++;
+    }
+
+    if (num_unique > 0) {
+        SfannWeights::blocks.push_back(make_pair((const fann_type *)res->input[0], (const fann_type *)(res->input[0] + (size_t)num_unique * (num_input + 1))));
+    }
+    return res;
+}
+
+void SfannWeights::forget(const struct fann_train_data * data) {
+    if (data == NULL || data->num_data == 0) return;
+    for (size_t b=0; b<SfannWeights::blocks.size(); b++) {
+        if (SfannWeights::blocks[b].first == data->input[0]) {
+            SfannWeights::blocks.erase(SfannWeights::blocks.begin() + b);
+            return;
+        }
+    }
+}
+
+bool SfannWeights::weighted(const struct fann_train_data * data) {
+    if (data == NULL || data->num_data == 0) return false;
+    const fann_type * row = data->input[0];
+    for (size_t b=0; b<SfannWeights::blocks.size(); b++) {
+        if (row >= SfannWeights::blocks[b].first && row < SfannWeights::blocks[b].second) return true;
+    }
+    return false;
+}
+
+unsigned long long SfannWeights::total(const struct fann_train_data * data) {
+    if (data == NULL) return 0;
+    if (!weighted(data)) return data->num_data;
+    unsigned long long n = 0;
+    for (unsigned int i=0; i<data->num_data; i++) n += weight(data, i);
+    return n;
+}
+
+void SfannWeights::compute_MSE(struct fann * net, fann_type * desired, unsigned int w) {
+    float mse = net->MSE_value;
+    unsigned int bit_fail = net->num_bit_fail;
+    fann_compute_MSE(net, desired);
+    if (w == 1) return;
+
+    // les erreurs se propagent lineairement : des erreurs de sortie multipliees par w donnent des pentes multipliees par w
+    net->MSE_value = mse + (net->MSE_value - mse) * w;
+    net->num_bit_fail = bit_fail + (net->num_bit_fail - bit_fail) * w;
+    net->num_MSE += w - 1;
+    fann_type * errors = net->train_errors + ((net->last_layer - 1)->first_neuron - net->first_layer->first_neuron);
+    for (unsigned int k=0; k<net->num_output; k++) errors[k] *= w;
+}
+
+float SfannWeights::train_epoch(struct fann * net, struct fann_train_data * data) {
+    if (!weighted(data) || fann_get_training_algorithm(net) != FANN_TRAIN_RPROP) {
+        return fann_train_epoch(net, data);
+    }
+    // meme deroulement que fann_train_epoch_irpropm
+    if (net->prev_train_slopes == NULL) fann_clear_train_arrays(net);
+    if (net->train_slopes == NULL) {
+        return fann_train_epoch(net, data);
+    }
+    fann_reset_MSE(net);
+    for (unsigned int i=0; i<data->num_data; i++) {
+        fann_run(net, data->input[i]);
+        compute_MSE(net, data->output[i], weight(data, i));
+        fann_backpropagate_MSE(net);
+        fann_update_slopes_batch(net, net->first_layer + 1, net->last_layer - 1);
+    }
+    fann_update_weights_irpropm(net, 0, net->total_connections);
+    return fann_get_MSE(net);
+}
@@ -0,0 +1,78 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+#ifndef __LIB_SFANNWEIGHTS__
+#define __LIB_SFANNWEIGHTS__
+
+#include <vector>
+#include <utility>
+#include "fann.h"
+
+using namespace std;
+
+
+// Exemples ponderes (--collapse-duplicates).
+//
+// Les exemples identiques (memes entrees et memes sorties) d'un corpus sont
+// remplaces par un seul exemple, dont le poids est le nombre de copies. Le
+// poids est range apres les entrees de chaque exemple (input[i][num_input]) :
+// les vues du corpus (melange, dev automatique) le suivent sans autre table.
+// Les epoques RPROP et les evaluations comptent chaque exemple autant de fois
+// que son poids : pentes, MSE et taux de classification sont ceux du corpus
+// complet, au regroupement des additions pres.
+class SfannWeights {
+
+    private:
+        // entrees des corpus ponderes (debut et fin du bloc)
+        static vector< pair<const fann_type *, const fann_type *> > blocks;
+
+    public:
+        // nouveau corpus fait des exemples distincts de <data>, dans l'ordre de leur premiere occurrence (<data> reste alloue)
+        static struct fann_train_data * collapse(const struct fann_train_data * data);
+        // a appeler avant de liberer un corpus rendu par collapse
+        static void forget(const struct fann_train_data * data);
+
+        // vrai si <data> (ou le corpus dont c'est une vue) vient de collapse
+        static bool weighted(const struct fann_train_data * data);
+        // poids de l'exemple <i> d'un corpus pondere
+        static unsigned int weight(const struct fann_train_data * data, unsigned int i) {return (unsigned int)data->input[i][data->num_input];};
+        // nombre d'exemples represente par <data> (num_data s'il n'est pas pondere)
+        static unsigned long long total(const struct fann_train_data * data);
+
+        // fann_compute_MSE pour un exemple de poids <w> : erreurs de sortie (donc pentes) et MSE multipliees par <w>
+        static void compute_MSE(struct fann * net, fann_type * desired, unsigned int w);
+        // equivalent pondere de fann_train_epoch (RPROP ; les autres algorithmes ignorent les poids)
+        static float train_epoch(struct fann * net, struct fann_train_data * data);
+};
+
+#endif
@@ -0,0 +1,279 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+// Banc d'essai de "make bench".
+//
+// Genere des corpus synthetiques deterministes (stem Icsiboost et fichiers FANN
+// des memes exemples), y lance le programme sfann avec --perf-report et ecrit
+// une ligne separee par des tabulations par phase mesuree :
+//   scenario  run  phase  count  seconds  examples  examples/sec  MB/sec
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+using namespace std;
+
+typedef struct bench_scenario {
+    const char * name;
+    int num_examples;
+    int num_continuous;
+    int num_label_params;
+    int labels_per_param;
+    int num_classes;
+    bool quick;
+} bench_scenario;
+
+static const bench_scenario scenarios[] = {
+    // nom                exemples cont labels card classes quick
+    {"cont-small",          2000,   16,    0,    0,    2,   true},
+    {"cont-wide",          20000,  128,    0,    0,    5,   false},
+    {"labels-wide",        20000,    4,   40,   25,    3,   true},
+    {"labels-many-classes",10000,    8,   10,   10,   20,   false},
+    {"large",             100000,   32,    8,   16,   10,   false},
+};
+
+// generateur deterministe (xorshift64*), identique sur toutes les plateformes
+class BenchRandom {
+    private:
+        unsigned long long state;
+    public:
+        BenchRandom(unsigned long long seed) {this->state = seed * 2685821657736338717ULL + 1;};
+        unsigned long long next() {
+            this->state ^= this->state >> 12;
+            this->state ^= this->state << 25;
+            this->state ^= this->state >> 27;
+            return this->state * 2685821657736338717ULL;
+        };
+        double uniform() {return (this->next() >> 11) * (1.0 / 9007199254740992.0);};
+        int below(int n) {return (int)(this->uniform() * n);};
+};
+
+typedef struct bench_example {
+    vector<float> continuous;
+    vector<int> labels;
+    int classe;
+} bench_example;
+
+static bench_example generate_example(const bench_scenario & s, BenchRandom & r) {
+    bench_example e;
+    // classe decidee par une regle fixe sur les parametres, pour que le reseau ait quelque chose a apprendre
+    double score = 0;
+    for (int i = 0; i < s.num_continuous; i++) {
+        float v = (float)(r.uniform() * 2 - 1);
+        e.continuous.push_back(v);
+        score += v * ((i % 3) - 1);
+    }
+    for (int i = 0; i < s.num_label_params; i++) {
+        int l = r.below(s.labels_per_param);
+        e.labels.push_back(l);
+        score += (l % 2) ? 0.5 : -0.5;
+    }
+    int c = (int)((score + s.num_continuous / 3.0 + s.num_label_params) * 7919) % s.num_classes;
+    if (c < 0) c += s.num_classes;
+    // un peu de bruit
+    if (r.uniform() < 0.1) c = r.below(s.num_classes);
+    e.classe = c;
+    return e;
+}
+
+static void write_names(const bench_scenario & s, const string & stem) {
+    ofstream f((stem + ".names").c_str());
+    for (int c = 0; c < s.num_classes; c++) f << (c ? ", " : "") << "c" << c;
+    f << ".\n";
+    for (int i = 0; i < s.num_continuous; i++) f << "x" << i << ": continuous.\n";
+    for (int i = 0; i < s.num_label_params; i++) {
+        f << "p" << i << ": ";
+        for (int l = 0; l < s.labels_per_param; l++) f << (l ? ", " : "") << "v" << l;
+        f << ".\n";
+    }
+}
+
+static int num_inputs(const bench_scenario & s) {
+    return s.num_continuous + s.num_label_params * s.labels_per_param;
+}
+
+// ecrit <num> exemples dans <stem><ext> (Icsiboost) et <stem><ext>.fann (FANN)
+static void write_corpus(const bench_scenario & s, const string & stem, const string & ext, int num, BenchRandom & r) {
+    FILE * icsi = fopen((stem + ext).c_str(), "w");
+    FILE * fann = fopen((stem + ext + ".fann").c_str(), "w");
+    if (icsi == NULL || fann == NULL) {
+        cerr << "Impossible write of " << stem << ext << " !" << endl;
+        exit(1);
+    }
+    fprintf(fann, "%d %d %d\n", num, num_inputs(s), s.num_classes);
+    for (int n = 0; n < num; n++) {
+        bench_example e = generate_example(s, r);
+        for (int i = 0; i < s.num_continuous; i++) {
+            fprintf(icsi, "%.5f, ", e.continuous[i]);
+            fprintf(fann, "%.5f ", e.continuous[i]);
+        }
+        for (int i = 0; i < s.num_label_params; i++) {
+            fprintf(icsi, "v%d, ", e.labels[i]);
+            for (int l = 0; l < s.labels_per_param; l++) fprintf(fann, l == e.labels[i] ? "1 " : "-1 ");
+        }
+        fprintf(icsi, "c%d.\n", e.classe);
+        fprintf(fann, "\n");
+        for (int c = 0; c < s.num_classes; c++) fprintf(fann, c == e.classe ? "1 " : "-1 ");
+        fprintf(fann, "\n");
+    }
+    fclose(icsi);
+    fclose(fann);
+}
+
+static unsigned long long file_size(const string & file) {
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) return 0;
+    return st.st_size;
+}
+
+// nombre de commandes sfann en echec, rendu par main
+static int failures = 0;
+
+// lit les phases d'un rapport ecrit par sfann --perf-report
+static void print_report(const string & scenario, const string & run, const string & report, FILE * out) {
+    ifstream f(report.c_str());
+    if (!f.is_open()) {
+        cerr << "Missing performance report " << report << " !" << endl;
+        failures++;
+        return;
+    }
+    string line;
+    while (getline(f, line)) {
+        size_t p = line.find("{\"name\": \"");
+        if (p == string::npos) continue;
+        char name[256];
+        unsigned long count;
+        double total, avg, mn, mx, ips, mbps;
+        unsigned long long items, bytes_read, bytes_alloc;
+        if (sscanf(line.c_str() + p, "{\"name\": \"%255[^\"]\", \"count\": %lu, \"total_sec\": %lf, \"avg_sec\": %lf, \"min_sec\": %lf, \"max_sec\": %lf, \"items\": %llu, \"items_per_sec\": %lf, \"bytes_read\": %llu, \"mb_per_sec\": %lf, \"bytes_allocated\": %llu",
+                   name, &count, &total, &avg, &mn, &mx, &items, &ips, &bytes_read, &mbps, &bytes_alloc) == 11) {
+            fprintf(out, "%s\t%s\t%s\t%lu\t%.6f\t%llu\t%.1f\t%.3f\n", scenario.c_str(), run.c_str(), name, count, total, items, ips, mbps);
+        }
+    }
+}
+
+static void run(const string & sfann, const string & scenario, const string & name, const string & args, const string & dir, FILE * out) {
+    string report = dir + "/" + scenario + "." + name + ".json";
+    remove(report.c_str());
+    string cmd = sfann + " " + args + " --perf-report " + report + " > " + dir + "/" + scenario + "." + name + ".log 2>&1";
+    if (system(cmd.c_str()) != 0) {
+        cerr << "Benchmark command failed : " << cmd << endl;
+        failures++;
+        return;
+    }
+    print_report(scenario, name, report, out);
+    fflush(out);
+}
+
+static void usage() {
+    cout << "Usage : sfann_bench [--sfann <binary>] [--dir <work dir>] [--output <tsv file>] [--quick] [--scenario <name>] [--epochs <n>]" << endl;
+    cout << "Scenarios :";
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) cout << " " << scenarios[i].name;
+    cout << endl;
+}
+
+int main(int ac, char ** av) {
+    string sfann = "./sfann";
+    string dir = "bench-data";
+    string output;
+    string only;
+    bool quick = false;
+    int epochs = 10;
+
+    for (int i = 1; i < ac; i++) {
+        string a = av[i];
+        if (a == "--sfann" && i + 1 < ac) sfann = av[++i];
+        else if (a == "--dir" && i + 1 < ac) dir = av[++i];
+        else if (a == "--output" && i + 1 < ac) output = av[++i];
+        else if (a == "--scenario" && i + 1 < ac) only = av[++i];
+        else if (a == "--epochs" && i + 1 < ac) epochs = atoi(av[++i]);
+        else if (a == "--quick") quick = true;
+        else {
+            usage();
+            return a == "--help" || a == "-h" ? 0 : 1;
+        }
+    }
+
+    mkdir(dir.c_str(), 0755);
+    FILE * out = stdout;
+    if (!output.empty()) {
+        out = fopen(output.c_str(), "w");
+        if (out == NULL) {
+            cerr << "Impossible write of " << output << " !" << endl;
+            return 1;
+        }
+    }
+
+    fprintf(out, "scenario\trun\tphase\tcount\tseconds\texamples\texamples_per_sec\tmb_per_sec\n");
+
+    ostringstream ep;
+    ep << epochs;
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        bench_scenario s = scenarios[i];
+        if (!only.empty() && only != s.name) continue;
+        if (quick && !s.quick) continue;
+        if (quick) s.num_examples /= 4;
+
+        string stem = dir + "/" + s.name;
+        BenchRandom r(i + 1);
+        cerr << "sfann_bench: generating " << s.name << " (" << s.num_examples << " examples, " << num_inputs(s) << " inputs, " << s.num_classes << " classes)" << endl;
+        write_names(s, stem);
+        write_corpus(s, stem, ".data", s.num_examples, r);
+        write_corpus(s, stem, ".test", s.num_examples / 10, r);
+        write_corpus(s, stem, ".dev", s.num_examples / 10, r);
+        fprintf(out, "%s\tcorpus\tfiles\t3\t0\t%d\t0\t%.3f\n", s.name, s.num_examples * 12 / 10,
+                (file_size(stem + ".data") + file_size(stem + ".test") + file_size(stem + ".dev")) / (1024. * 1024.));
+
+        string common = " --num-hidden 32 --max-epoch " + ep.str() + " --reports 1";
+        cerr << "sfann_bench: " << s.name << " training" << endl;
+        run(sfann, s.name, "train", "--do-training --stem " + stem + common + " --save-max-dev " + stem + ".net", dir, out);
+        cerr << "sfann_bench: " << s.name << " cross-validation" << endl;
+        run(sfann, s.name, "cv", "--do-cross-validation --train " + stem + ".data.fann --cv-num-folds 5 --num-hidden 32 --max-epoch 2 --reports 2", dir, out);
+        cerr << "sfann_bench: " << s.name << " scoring" << endl;
+        run(sfann, s.name, "run", "--do-running --load-ann " + stem + ".net --test " + stem + ".test.fann", dir, out);
+    }
+
+    if (out != stdout) fclose(out);
+    if (failures > 0) {
+        cerr << "sfann_bench: " << failures << " failed command(s), " << (output.empty() ? "the output" : output) << " is incomplete" << endl;
+        return 1;
+    }
+    return 0;
+}
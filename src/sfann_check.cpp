@@ -0,0 +1,144 @@
+//
+//   ------------------------------------------------------------------
+//      Sfann v0.1 : Simple and Fast Artificial Neural Networks
+//   ------------------------------------------------------------------
+//
+//      Copyright (C) 2010 Stanislas Oger
+//
+//   ..................................................................
+//
+//      This file is part of Sfann
+//
+//      Sfann is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//   ..................................................................
+//
+//      Contact :
+//                stanislas.oger@gmail.com
+//   ..................................................................
+//
+
+
+// Verifications lancees par "make check".
+//
+// Chaque verification affiche une ligne "ok" ou "FAILED" ; le programme rend
+// le nombre de verifications en echec.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "SfannFolds.hpp"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string & name) {
+    cout << (ok ? "ok     " : "FAILED ") << name << endl;
+    if (!ok) failures++;
+}
+
+// index des classes d'un corpus de <num_data> exemples et <num_classes> classes
+static vector< vector<unsigned int> > make_classes(unsigned int num_data, unsigned int num_classes) {
+    vector< vector<unsigned int> > by_class(num_classes);
+    for (unsigned int i = 0; i < num_data; i++) by_class[(i * 7) % num_classes].push_back(i);
+    return by_class;
+}
+
+static bool same_folds(const folds & a, const folds & b) {
+    return a.num_folds == b.num_folds && a.num_data == b.num_data && a.indices == b.indices;
+}
+
+// --cv-repeats : les folds de la repetition r sont ceux d'une repetition seule de graine seed + r
+static void check_fold_repetitions() {
+    const unsigned int seed = 42;
+    const int num_folds = 10, repeats = 4;
+    vector< vector<unsigned int> > by_class = make_classes(257, 3);
+
+    // meme enchainement que la validation croisee : un seul index des classes pour toutes les repetitions
+    vector<folds> series(repeats);
+    for (int r = 0; r < repeats; r++) {
+        SfannRandom rng(seed + r);
+        SfannFolds::stratify(by_class, series[r], num_folds, &rng);
+    }
+
+    bool replayed = true, distinct = true;
+    for (int r = 0; r < repeats; r++) {
+        vector< vector<unsigned int> > fresh = make_classes(257, 3);
+        SfannRandom rng(seed + r);
+        folds alone;
+        SfannFolds::stratify(fresh, alone, num_folds, &rng);
+        if (!same_folds(series[r], alone)) replayed = false;
+        if (r > 0 && same_folds(series[r], series[r - 1])) distinct = false;
+    }
+    check(replayed, "cross-validation repetition r has the folds of a single run seeded seed+r");
+    check(distinct, "cross-validation repetitions have different folds");
+
+    // chaque fold a le meme nombre d'exemples, a un exemple pres
+    bool balanced = true;
+    for (size_t f = 0; f < series[0].indices.size(); f++) {
+        size_t size = series[0].indices[f].size();
+        if (size < 257 / num_folds || size > 257 / num_folds + 1) balanced = false;
+    }
+    check(balanced && series[0].num_data == 257, "folds are of the same size and cover the corpus");
+}
+
+// stratification : dans chaque fold, le nombre d'exemples de chaque classe est a un pres celui de la classe divise par
+// le nombre de folds, y compris pour une classe rare qui a moins d'exemples que de folds
+static void check_stratification() {
+    const int num_folds = 10;
+    const unsigned int class_size[] = { 900, 97, 31, 4 };
+    const unsigned int num_classes = sizeof(class_size) / sizeof(class_size[0]);
+
+    // classes desequilibrees, exemples entremeles dans le corpus
+    vector< vector<unsigned int> > by_class(num_classes);
+    vector<int> label;
+    vector<unsigned int> left(class_size, class_size + num_classes);
+    for (unsigned int i = 0, c = 0; label.size() < 900 + 97 + 31 + 4; i++, c = (c + 1) % num_classes) {
+        if (left[c] == 0) continue;
+        left[c]--;
+        by_class[c].push_back(label.size());
+        label.push_back(c);
+    }
+
+    SfannRandom rng(7);
+    folds _folds;
+    SfannFolds::stratify(by_class, _folds, num_folds, &rng);
+
+    bool stratified = true, covered = true;
+    vector<int> seen(label.size(), 0);
+    for (int f = 0; f < num_folds; f++) {
+        vector<unsigned int> count(num_classes, 0);
+        for (size_t k = 0; k < _folds.indices[f].size(); k++) {
+            unsigned int i = _folds.indices[f][k];
+            if (i >= label.size()) { covered = false; continue; }
+            seen[i]++;
+            count[label[i]]++;
+        }
+        for (unsigned int c = 0; c < num_classes; c++) {
+            double expected = (double) class_size[c] / num_folds;
+            if (count[c] + 1 <= expected || count[c] >= expected + 1) stratified = false;
+        }
+    }
+    for (size_t i = 0; i < seen.size(); i++) if (seen[i] != 1) covered = false;
+    check(stratified, "every fold holds class_size/num_folds examples of each class, to one example (rare class included)");
+    check(covered && _folds.num_data == (int) label.size(), "every example is in exactly one fold");
+}
+
+int main() {
+    check_fold_repetitions();
+    check_stratification();
+    return failures;
+}
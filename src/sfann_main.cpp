@@ -60,7 +60,18 @@ int main(int ac, char ** av) {
         exit(1);
     }
 
-	sa->do_training();
+    try {
+        sa->do_training();
+    } catch (exception & se) {
+        cerr << "Error during training : " << se.what() << "\n";
+        exit(1);
+    }
+
+    try {
+        sa->write_perf_report();
+    } catch (exception & se) {
+        cerr << "Error when writing the performance report : " << se.what() << "\n";
+    }
 
 	Sfann::deleteInstance();
 }